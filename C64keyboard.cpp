@@ -23,6 +23,7 @@
 
 #include "C64keyboard.hpp"
 #include "c64key.h"
+#include "trace.h"
 
 // Map codes to pins
 /*
@@ -71,6 +72,10 @@ void C64keyboard::resetSwitch(void) {
   switchState[0] = switchState[1] = switchState[2] = 0;
   switchState[3] = switchState[4] = switchState[5] = 0;
   switchState[6] = switchState[7] = 0;
+  joy1State = 0;
+  for (uint8_t i = 0; i < KEY_LEASES; i++) {
+    leases[i].key = CK_IGNORE_KEYCODE;
+  }
   for (int i = 0; i < 0x40; i++) {
     setSwitch(i, 0);
   }
@@ -87,6 +92,7 @@ void C64keyboard::setSwitch(uint8_t swCode, uint8_t data) {
   } else {
     switchState[b] &= ~(1 << a);
   }
+  TRACE(TRACE_SWITCH, swCode, data);
 
   a = am[a];
   b = bm[b];
@@ -117,6 +123,88 @@ void C64keyboard::setSwitch(uint8_t swCode, uint8_t data) {
   digitalWrite(ANALOG_SW_STROBE, LOW);
 }
 
+void C64keyboard::setJoy1(uint8_t bits) {
+  static const uint8_t joy1Switch[] = {
+    CKM_JOY1_UP, CKM_JOY1_DOWN, CKM_JOY1_LEFT, CKM_JOY1_RIGHT, CKM_JOY1_BUTTON
+  };
+  uint8_t changed = bits ^ joy1State;
+  joy1State = bits;
+  for (uint8_t i = 0; i < 5; i++) {
+    if (changed & (1 << i)) {
+      setSwitch(joy1Switch[i], (bits >> i) & 1);
+    }
+  }
+}
+
+static keyLease *findLease(keyLease *leases, uint8_t c) {
+  for (uint8_t i = 0; i < KEY_LEASES; i++) {
+    if (leases[i].key != CK_IGNORE_KEYCODE && (leases[i].key & 0xff) == c) {
+      return &leases[i];
+    }
+  }
+  return NULL;
+}
+
+void C64keyboard::leaseKey(uint16_t code, uint8_t source) {
+  uint8_t c = code & 0xff;
+  // Matrix keys and RESTORE stay down until released
+  if (c >= 0x40 && c != CK_RESTORE) {
+    return;
+  }
+  keyLease *l = findLease(leases, c);
+  if (!(code & FLAG_KEYDOWN)) {
+    if (l) {
+      l->key = CK_IGNORE_KEYCODE;
+    }
+    return;
+  }
+  for (uint8_t i = 0; i < KEY_LEASES && !l; i++) {
+    if (leases[i].key == CK_IGNORE_KEYCODE) {
+      l = &leases[i];
+    }
+  }
+  if (!l) {
+    // Without a free slot the key waits for its release frame
+    return;
+  }
+  l->key = code & ~(FLAG_KEYDOWN | FLAG_TYPEMATIC);
+  l->expires = millis() + leaseTime;
+  l->source = source;
+}
+
+void C64keyboard::renewLease(uint8_t c) {
+  keyLease *l = findLease(leases, c);
+  if (l) {
+    l->expires = millis() + leaseTime;
+  }
+}
+
+void C64keyboard::renewLeases(uint8_t source) {
+  uint16_t expires = millis() + leaseTime;
+  for (uint8_t i = 0; i < KEY_LEASES; i++) {
+    if (leases[i].key != CK_IGNORE_KEYCODE && leases[i].source == source) {
+      leases[i].expires = expires;
+    }
+  }
+}
+
+uint16_t C64keyboard::expireLease(void) {
+  uint16_t now = millis();
+  for (uint8_t i = 0; i < KEY_LEASES; i++) {
+    uint16_t k = leases[i].key;
+    if (k != CK_IGNORE_KEYCODE && (int16_t)(leases[i].expires - now) < 0) {
+      leases[i].key = CK_IGNORE_KEYCODE;
+      leaseExpired++;
+      if (debug) {
+        Serial.print("Lease expired: 0x");
+        Serial.println(k & 0xff, HEX);
+      }
+      return k;
+    }
+  }
+  return CK_IGNORE_KEYCODE;
+}
+
 void C64keyboard::c64key(uint16_t code) {
   uint8_t c = code & 0xff;
   uint8_t autoShift = !!(code & FLAG_AUTOSHIFT);
@@ -131,6 +219,7 @@ void C64keyboard::c64key(uint16_t code) {
       break;
 
     case CK_RESTORE:
+      TRACE(TRACE_NMI, 0, keyDown);
       if (keyDown) {
         pinMode (nmiPin, OUTPUT);
         digitalWrite (nmiPin, LOW);
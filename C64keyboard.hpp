@@ -50,6 +50,8 @@
 // Flags for c64key()
 #define FLAG_KEYDOWN 0x100
 #define FLAG_AUTOSHIFT 0x200
+#define FLAG_TYPEMATIC 0x400 // Ignored by c64key(), see typematic.h
+#define FLAG_MACRO 0x800     // Low byte is a macro number, not for c64key()
 
 // Special mappings in addition to CKM_ codes
 #define CK_RESET 0xab
@@ -60,6 +62,34 @@
 
 #define CK_IGNORE_KEYCODE 0xb0
 
+// Joystick port 1 shares CIA1 port B with the keyboard matrix. A joystick
+// line pulled low reads as a key in row PA7, which the KERNAL leaves
+// selected after scanning the keyboard.
+#define CKM_JOY1_UP     0x38 // CKM_1
+#define CKM_JOY1_DOWN   0x39 // CKM_LEFT_ARROW
+#define CKM_JOY1_LEFT   0x3a // CKM_CTRL
+#define CKM_JOY1_RIGHT  0x3b // CKM_2
+#define CKM_JOY1_BUTTON 0x3c // CKM_SPACE
+
+// Pressed keys are leased. A key whose lease is not renewed by repeat
+// frames or released within leaseTime is released by expireLease().
+// Keyboards repeat only the last key pressed, so a repeat frame renews
+// every key its source holds.
+#define KEY_LEASES 8
+#define KEY_LEASE_MS 1000
+
+// Sources of leased keys
+#define LEASE_IR 0
+#define LEASE_PS2 1
+#define LEASE_RECORDER 2
+#define LEASE_LEARNED 3
+
+struct keyLease {
+  uint16_t key;      // c64key() code without FLAG_KEYDOWN, CK_IGNORE_KEYCODE if free
+  uint16_t expires;  // Low 16 bits of millis()
+  uint8_t source;
+};
+
 // Flags for keymap entries
 // Input shift flags. If set, the key rule is used
 #define IR_NO_SHIFT 0x01
@@ -67,6 +97,10 @@
 // Output shift state
 #define CKM_NO_SHIFT 0x10
 #define CKM_SHIFT 0x20
+// Repeated by the typematic engine while held
+#define CKM_REPEAT 0x40
+// Types macro number ckmKey, see macro.h
+#define CKM_MACRO 0x80
 
 
 class C64keyboard {
@@ -79,6 +113,17 @@ class C64keyboard {
     void resetSwitch(void);
     void setSwitch(uint8_t c, uint8_t data);
     void c64key(uint16_t k);
+    // Bits 0..4: up, down, left, right, button
+    void setJoy1(uint8_t bits);
+
+    // Take or drop the lease of a c64key() code
+    void leaseKey(uint16_t k, uint8_t source);
+    void renewLease(uint8_t c);
+    // Renew the leases of all keys held by a source
+    void renewLeases(uint8_t source);
+    // Drop one expired lease. Returns the release code of its key, for
+    // the caller to apply, or CK_IGNORE_KEYCODE.
+    uint16_t expireLease(void);
 
     // Set true for serial monitor of C64 keycodes and IR keycodes
     bool debug = true;
@@ -87,5 +132,10 @@ class C64keyboard {
     int nmiPin;
     volatile bool lshift = false, rshift = false, capslock = false ;
     uint8_t switchState[8];
+    uint8_t joy1State;
+    keyLease leases[KEY_LEASES];
+    uint16_t leaseTime = KEY_LEASE_MS;
+    // Number of keys released by an expired lease
+    uint16_t leaseExpired;
 };
 #endif
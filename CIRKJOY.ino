@@ -23,10 +23,23 @@
 */
 
 #include <avr/wdt.h>
+#include <avr/sleep.h>
 
 #include "C64keyboard.hpp"
 #include "mapping.h"
 #include "irkey.h"
+#include "irmerge.h"
+#include "ps2key.h"
+#include "autofire.h"
+#include "joyfilter.h"
+#include "joymix.h"
+#include "recorder.h"
+#include "irlearn.h"
+#include "typematic.h"
+#include "keysched.h"
+#include "macro.h"
+#include "trace.h"
+#include "crashlog.h"
 
 // IR Receiver (TSOP4838)
 //const int IR_RECEIVE_PIN = A5;
@@ -38,30 +51,84 @@ const int JOY_RIGHT_PIN = A3;
 const int JOY_BUTTON_PIN = A4;
 
 // C64 Restore key
-const int NMI_PIN = 2;
+#define NMI_PIN 2
 
-//PS2 communication pins
-//const int PS2_DATA_PIN=        A0; // Data pin for PS2 keyboard
-//const int PS2_IRQ_PIN  =       2;  // Interrupt (clk) pin for PS2 keyboard
+// PS2 keyboard pins are in ps2key.h
+#if defined(PS2_CLOCK_PIN) && (PS2_CLOCK_PIN == NMI_PIN || PS2_CLOCK_PIN == ANALOG_SW_DATA)
+#error "The PS/2 clock cannot share a pin with RESTORE or the MT8816 data"
+#endif
+#if defined(PS2_DATA_PIN) && (PS2_DATA_PIN == NMI_PIN || PS2_DATA_PIN == ANALOG_SW_DATA)
+#error "The PS/2 data cannot share a pin with RESTORE or the MT8816 data"
+#endif
 
 //IRrecv irrecv(IR_RECEIVE_PIN);
 
+// Serial control character that prints the IR decode counters
+#define SERIAL_QUERY_STATS 0x05 // ENQ
+
+// Joystick direction is held for JOY_TIMEOUT_FRAMES times the measured
+// interval of remote joystick frames, limited to MIN..MAX milliseconds
+#define JOY_TIMEOUT_FRAMES 3
+#define JOY_TIMEOUT_MIN 40
+#define JOY_TIMEOUT_MAX 200
+
 C64keyboard ckey;
 
-static uint16_t mapKey(uint32_t irData);
-static void handleButtons(uint32_t k);
-static uint8_t handleJoyMode(uint32_t k);
-static void handleJoystick(uint32_t k);
-static void debugIRCode(uint32_t data);
+static void handleIRData(IREvent irData, uint8_t source);
+static uint8_t isRecorderKey(IREvent irData);
+static uint16_t mapKey(IREvent irData);
+static void renewModifiers(IREvent irData);
+static void handleButtons(IREvent k);
+static uint8_t handleJoyMode(IREvent k);
+static void releaseKeyboardJoy(void);
+static void handleJoystick(IREvent k);
+static void outputKey(uint16_t ck, uint8_t source);
+static void scheduleKey(uint16_t ck);
+static void applyKeys(void);
+static void handleLearned(uint16_t target);
+static uint8_t learnTarget(IREvent irData);
+static void measureJoyInterval(void);
+static void cycleAutofire(uint8_t source1, uint8_t source2);
+static void debugIRCode(IREvent data);
+static void debugReceivers(void);
+static void idle(void);
 
 static uint32_t joyTimeout;
-static uint8_t joyStatus;
+static uint32_t joyLastFrame;
+static uint16_t joyFrameInterval = JOY_TIMEOUT_MAX / JOY_TIMEOUT_FRAMES;
 static uint8_t joyMoveLimit = 16;
+static joyfilter joyX, joyY;
 static uint8_t keyboardJoyMode;
 
+// Activity LED, unless its pin is used by the second IR receiver or PS/2
+#if defined(IR2_RECEIVE_PIN) && IR2_RECEIVE_PIN == LED_BUILTIN
+#define ACTIVITY_LED 0
+#elif defined(PS2_DATA_PIN) && PS2_DATA_PIN == LED_BUILTIN
+#define ACTIVITY_LED 0
+#else
+#define ACTIVITY_LED 1
+#endif
+
+#if ACTIVITY_LED
+static uint8_t ledOn;
+#endif
+
+// Keyboard joystick modes
+#define JOY_MODE_OFF 0
+#define JOY_MODE_PORT2 1 // Direct joystick pins
+#define JOY_MODE_PORT1 2 // Keyboard matrix
+
+// Autofire rates selectable from the remote, in frames per button toggle
+static const uint8_t autofireRates[] = {0, 2, 3, 5};
+
 void setup() {
+  Serial.begin( 115200 );
+  // Before anything is traced over the log of a watchdog reset
+  crashlog_begin();
 
+#if ACTIVITY_LED
   pinMode(LED_BUILTIN, OUTPUT);
+#endif
 
   pinMode(JOY_UP_PIN, INPUT_PULLUP);
   pinMode(JOY_DOWN_PIN, INPUT_PULLUP);
@@ -75,199 +142,458 @@ void setup() {
   digitalWrite (JOY_BUTTON_PIN, HIGH);
 
   IR_setup();
+  PS2_setup();
+  irlearn_begin();
+  autofire_begin(JOY_BUTTON_PIN);
+  joymix_begin(JOY_UP_PIN, JOY_DOWN_PIN, JOY_LEFT_PIN, JOY_RIGHT_PIN);
+  typematic_begin(pgm_read_word(&C64Typematic_main.delay), pgm_read_byte(&C64Typematic_main.rate));
+  keysched_begin();
 
   ckey.debug = false;
   ckey.begin(NMI_PIN);
 
-  Serial.begin( 115200 );
   if (ckey.debug) {
     Serial.println("C64 IR keyboard");
     Serial.println(F("Build date " __DATE__));
   }
-}
 
-void loop() {
+  set_sleep_mode(SLEEP_MODE_IDLE);
   wdt_enable(WDTO_1S);     // enable the watchdog
+}
 
+void loop() {
+  // A wired keyboard gives the same events as the IR keyboard
   uint32_t irData = read_IR();
+  uint8_t source = LEASE_IR;
+  if (!irData) {
+    irData = read_PS2();
+    source = LEASE_PS2;
+  }
+  if (irData) {
+    if (recorder_recording() && !isRecorderKey(irData)) {
+      recorder_event(irData);
+    }
+    handleIRData(irData, source);
+  }
+  // Recorded events take the same path as received ones
+  irData = recorder_poll();
   if (irData) {
-    digitalWrite(LED_BUILTIN, HIGH);
+    handleIRData(irData, LEASE_RECORDER);
+  }
+  uint16_t ck;
+  // Buttons of other remotes
+  uint32_t other = IR_readOther();
+  if (other) {
+    irlearn_frame(other);
+  }
+  if (irlearn_poll(&ck)) {
+    handleLearned(ck);
+  }
+  applyKeys();
+  if (typematic_poll(&ck)) {
+    scheduleKey(ck);
+  }
+  if (macro_poll(&ck)) {
+    scheduleKey(ck);
+  }
+  // Release keys whose release frame was lost
+  ck = ckey.expireLease();
+  if (ck != CK_IGNORE_KEYCODE) {
+    scheduleKey(ck);
+    typematic_key(ck);
+  }
+  if (joyTimeout && (long)(joyTimeout - millis()) < 0) {
+    handleJoystick(0);
+  }
+
+  // Serial input waits in its buffer while the typing queue is full
+  int c = macro_full() ? -1 : Serial.read();
+  if (c == SERIAL_QUERY_STATS) {
+    IR_printStats();
+  } else if (c >= 0) {
+    // Typed as text, characters without a key are skipped
     if (ckey.debug) {
-      debugIRCode(irData);
+      Serial.print("Serial: 0x");
+      Serial.println(c, HEX);
     }
-    if (IR_GET_KEYBOARD(irData)) {
-      if (!IR_GET_RELEASE(irData)) {
-        switch (IR_GET_CODE(irData)) {
-          case IR_KC_VOL_DN:
-            joyMoveLimit = 8;
-            break;
-          case IR_KC_VOL_UP:
-            joyMoveLimit = 16;
-            break;
-          case IR_KC_MUTE:
-            joyMoveLimit = 24;
-            break;
-          case IR_KC_SLEEP:
-            keyboardJoyMode = 1;
-            break;
-          case IR_KC_HELP:
-            ckey.debug = 1;
-            Serial.println("C64 IR keyboard");
-            Serial.println(F("Build date " __DATE__));
-            break;
-          case IR_KC_CLOSE:
-          case IR_KC_POWER:
-            //if ((ck & 0xff) == CK_RESET) {
-            handleButtons(0);
-            handleJoystick(0);
-            keyboardJoyMode = 0;
-            ckey.debug = false;
-            break;
-        }
-      }
-      if (!keyboardJoyMode || !handleJoyMode(irData)) {
-        // Normal key processing
-        uint16_t ck = mapKey(irData);
-        ckey.c64key(ck);
+    macro_char(c);
+  }
+#if ACTIVITY_LED
+  if (ledOn) {
+    digitalWrite(LED_BUILTIN, LOW);
+    ledOn = 0;
+  }
+#endif
+  TRACE_FLUSH();
+  crashlog_loop(millis());
+  wdt_reset();
+  idle();
+}
+
+/* Sleep in idle mode until the next interrupt. A finished IR frame is
+ * noticed by the IRremote Timer2 tick every 50 us, serial input by the
+ * USART receive interrupt, PS/2 bytes by the clock interrupt, and the
+ * joystick and replay deadlines by the millis() Timer0 interrupt every
+ * 1 ms, which bounds the wake up latency.
+ * Work is checked with interrupts off, so that an interrupt between the
+ * check and the sleep instruction cannot be missed.
+ */
+static void idle(void) {
+  cli();
+  if (!IR_available() && !PS2_available() && !(Serial.available() && !macro_full())
+      && !recorder_busy() && !typematic_busy() && !macro_busy() && !irlearn_busy()
+      && !keysched_busy()
+      && !(joyTimeout && (long)(joyTimeout - millis()) < 0)) {
+    sleep_enable();
+    sei();
+    sleep_cpu();
+    sleep_disable();
+  }
+  sei();
+}
+
+static void handleIRData(IREvent irData, uint8_t source) {
+#if ACTIVITY_LED
+  digitalWrite(LED_BUILTIN, HIGH);
+  ledOn = 1;
+#endif
+  if (ckey.debug) {
+    debugIRCode(irData);
+  }
+  if (irlearn_pending() && learnTarget(irData)) {
+    return;
+  }
+  if (irData.isKeyboard()) {
+    if (irData.repeat()) {
+      // Keys are held until release and repeated by the typematic engine.
+      // Repeat frames only tell that the keys are still down.
+      ckey.renewLeases(source);
+      renewModifiers(irData);
+      return;
+    }
+    if (!irData.release()) {
+      switch (irData.code()) {
+        case IR_KC_VOL_DN:
+          joyMoveLimit = 8;
+          break;
+        case IR_KC_VOL_UP:
+          joyMoveLimit = 16;
+          break;
+        case IR_KC_MUTE:
+          joyMoveLimit = 24;
+          break;
+        case IR_KC_PREV_TR:
+          cycleAutofire(AUTOFIRE_BUTTON1, AUTOFIRE_KEYB_SPACE);
+          break;
+        case IR_KC_NEXT_TR:
+          cycleAutofire(AUTOFIRE_BUTTON2, AUTOFIRE_KEYB_SHIFT);
+          break;
+        case IR_KC_RECORD:
+          recorder_start();
+          break;
+        case IR_KC_MENU:
+          // Learn buttons of other remotes until MENU again
+          if (irlearn_learning()) {
+            irlearn_stop();
+          } else {
+            irlearn_start();
+          }
+          if (ckey.debug) {
+            Serial.println(irlearn_learning() ? "Learn: press a remote button" : "Learn: off");
+          }
+          break;
+        case IR_KC_PLAY:
+          recorder_play();
+          break;
+        case IR_KC_STOP:
+          recorder_stop();
+          break;
+        case IR_KC_SLEEP:
+          // Toggle keyboard joystick between port 2 and port 1. Held
+          // directions and fire stay on the old port unless released.
+          releaseKeyboardJoy();
+          if (keyboardJoyMode == JOY_MODE_PORT2) {
+            keyboardJoyMode = JOY_MODE_PORT1;
+          } else {
+            keyboardJoyMode = JOY_MODE_PORT2;
+          }
+          break;
+        case IR_KC_HELP:
+          ckey.debug = 1;
+          Serial.println("C64 IR keyboard");
+          Serial.println(F("Build date " __DATE__));
+          Serial.print("Leases expired: ");
+          Serial.println(ckey.leaseExpired);
+          debugReceivers();
+#ifdef PS2_CLOCK_PIN
+          Serial.print("PS2 errors: ");
+          Serial.println(PS2_errors());
+#endif
+          IR_printStats();
+          break;
+        case IR_KC_CLOSE:
+        case IR_KC_POWER:
+          //if ((ck & 0xff) == CK_RESET) {
+          handleButtons(0);
+          handleJoystick(0);
+          releaseKeyboardJoy();
+          typematic_stop();
+          macro_stop();
+          irlearn_stop();
+          keyboardJoyMode = JOY_MODE_OFF;
+          ckey.debug = false;
+          break;
       }
+    }
+    if (!keyboardJoyMode || !handleJoyMode(irData)) {
+      // Normal key processing
+      outputKey(mapKey(irData), source);
+    }
 
-    } else {
-      handleButtons(irData);
-      handleJoystick(irData);
+  } else {
+    measureJoyInterval();
+    handleButtons(irData);
+    handleJoystick(irData);
+  }
+  if (ckey.debug) {
+    uint8_t joyStatus = joymix_output() | !!autofire_held() << 4;
+    for (uint32_t t = 0x10; t; t >>= 1) {
+      Serial.write(joyStatus & t ? '1' : '0');
     }
-    if (ckey.debug) {
-      for (uint32_t t = 0x10; t; t >>= 1) {
-        Serial.write(joyStatus & t ? '1' : '0');
+    Serial.write(' ');
+    for (uint32_t t = 0x10; t; t >>= 1) {
+      Serial.write(ckey.joy1State & t ? '1' : '0');
+    }
+    Serial.println();
+  }
+}
+
+static void outputKey(uint16_t ck, uint8_t source) {
+  if (ck & FLAG_MACRO) {
+    if (ck & FLAG_KEYDOWN) {
+      macro_start((const char *)pgm_read_ptr(&C64Macros[ck & 0xff]));
+    }
+    return;
+  }
+  scheduleKey(ck);
+  // A wired keyboard cannot lose a break code, and irlearn releases
+  // learned keys IRLEARN_HOLD_MS after the last frame of their button
+  if (source != LEASE_PS2 && source != LEASE_LEARNED) {
+    ckey.leaseKey(ck, source);
+  }
+  typematic_key(ck);
+}
+
+// Key events pass through keysched, or go straight to the matrix when
+// its lane is full. RESET releases every key, so typing and repeat stop.
+static void scheduleKey(uint16_t ck) {
+  if ((ck & 0xff) == CK_RESET && (ck & FLAG_KEYDOWN)) {
+    macro_stop();
+    typematic_stop();
+  }
+  if (!keysched_key(ck)) {
+    ckey.c64key(ck);
+  }
+  applyKeys();
+}
+
+// Key events that have been held back long enough go to the matrix
+static void applyKeys(void) {
+  uint16_t ck;
+  while (keysched_poll(&ck)) {
+    ckey.c64key(ck);
+  }
+}
+
+/* While a button of another remote waits for its target, the next key
+ * press or pushed remote stick is bound to it instead of being used.
+ * MENU forgets the button. Returns 1 if the event was taken.
+ */
+static uint8_t learnTarget(IREvent irData) {
+  uint16_t target;
+  if (irData.isKeyboard()) {
+    if (irData.release() || irData.repeat()) {
+      return 0;
+    }
+    if (irData.code() == IR_KC_MENU) {
+      target = IRLEARN_NONE;
+    } else {
+      target = mapKey(irData) & ~FLAG_KEYDOWN;
+      if ((target & 0xff) == CK_IGNORE_KEYCODE) {
+        return 0;
       }
-      Serial.println();
     }
+  } else {
+    int8_t x = irData.joyX();
+    int8_t y = irData.joyY();
+    target = (y >= joyMoveLimit) | (y <= -joyMoveLimit) << 1
+      | (x <= -joyMoveLimit) << 2 | (x >= joyMoveLimit) << 3
+      | (irData.button1() || irData.button2()) << 4;
+    if (!target) {
+      return 0;
+    }
+    target |= IRLEARN_JOY;
   }
-  if (joyTimeout && (long)(joyTimeout - millis()) < 0) {
-    handleJoystick(0);
+  uint8_t ok = irlearn_bind(target);
+  if (ckey.debug) {
+    Serial.print(ok ? "Learn: bound 0x" : "Learn: table full 0x");
+    Serial.println(target, HEX);
   }
+  return 1;
+}
 
-  int c = Serial.read();
-  if (c >= 32) {
-    // FIXME. needs mapping
-    Serial.print("Serial: 0x");
-    Serial.println(c, HEX);
-    ckey.c64key(c | FLAG_KEYDOWN);
-    delay(200);
-    ckey.c64key(c);
+// Key or joystick bits of a learned button
+static void handleLearned(uint16_t target) {
+  if (!(target & IRLEARN_JOY)) {
+    outputKey(target, LEASE_LEARNED);
+    return;
   }
-  digitalWrite(LED_BUILTIN, LOW);
-  wdt_reset();
+  uint8_t down = !!(target & FLAG_KEYDOWN);
+  joymix_set(JOYMIX_LEARNED, down ? target & 0xf : 0);
+  autofire_hold(AUTOFIRE_LEARNED, down && (target & 0x10));
 }
 
-#define SET_TIMEOUT() joyTimeout= millis() + 200
+static uint8_t isRecorderKey(IREvent irData) {
+  if (!irData.isKeyboard()) {
+    return 0;
+  }
+  uint8_t kc = irData.code();
+  return kc == IR_KC_RECORD || kc == IR_KC_PLAY || kc == IR_KC_STOP;
+}
+
+#define SET_TIMEOUT() joyTimeout= millis() + joyHoldTime()
 #define CLEAR_TIMEOUT() joyTimeout= 0;
 
-// value==1 means button pushed
-static inline void setPin_(int pin, int value) {
-  if (value) {
-    pinMode(pin, OUTPUT);
-    digitalWrite(pin, LOW);
-  } else {
-#define EXTENAL_PULLUP 1
-#if EXTENAL_PULLUP
-    pinMode(pin, INPUT_PULLUP);
-#else
-    pinMode(pin, OUTPUT);
-    digitalWrite(pin, HIGH);
-#endif
+static void measureJoyInterval(void) {
+  uint32_t now = millis();
+  uint32_t interval = now - joyLastFrame;
+  joyLastFrame = now;
+  // Longer pauses are gaps between stick movements, not frame intervals
+  if (interval < JOY_TIMEOUT_MAX) {
+    joyFrameInterval = (joyFrameInterval * 3 + interval) / 4;
   }
 }
 
-static uint8_t handleJoyMode(uint32_t irData) {
-  uint8_t kc = IR_GET_CODE(irData);
-  uint8_t keyDown = !IR_GET_RELEASE(irData);
+static uint16_t joyHoldTime(void) {
+  uint16_t t = joyFrameInterval * JOY_TIMEOUT_FRAMES;
+  if (t < JOY_TIMEOUT_MIN) {
+    return JOY_TIMEOUT_MIN;
+  }
+  if (t > JOY_TIMEOUT_MAX) {
+    return JOY_TIMEOUT_MAX;
+  }
+  return t;
+}
+
+static uint8_t handleJoyMode(IREvent irData) {
+  uint8_t kc = irData.code();
+  uint8_t keyDown = !irData.release();
+  uint8_t bit;
+  uint8_t source = 0;
   switch (kc) {
     case IR_KC_UP_ARROW:
     case IR_KC_W:
-      setPin_(JOY_UP_PIN, keyDown);
-      joyStatus &= ~1;
-      joyStatus |= keyDown << 0;
-      return 1;
+      bit = 0;
+      break;
     case IR_KC_DN_ARROW:
     case IR_KC_S:
-      setPin_(JOY_DOWN_PIN, keyDown);
-      joyStatus &= ~2;
-      joyStatus |= keyDown << 1;
-      return 1;
+      bit = 1;
+      break;
     case IR_KC_L_ARROW:
     case IR_KC_A:
-      setPin_(JOY_LEFT_PIN, keyDown);
-      joyStatus &= ~4;
-      joyStatus |= keyDown << 2;
-      return 1;
+      bit = 2;
+      break;
     case IR_KC_R_ARROW:
     case IR_KC_D:
-      setPin_(JOY_RIGHT_PIN, keyDown);
-      joyStatus &= ~8;
-      joyStatus |= keyDown << 3;
-      return 1;
+      bit = 3;
+      break;
     case IR_KC_SPACE:
+      bit = 4;
+      source = AUTOFIRE_KEYB_SPACE;
+      break;
     case IR_KC_L_SHIFT:
     case IR_KC_R_SHIFT:
     case IR_KC_L_CTRL:
-      setPin_(JOY_BUTTON_PIN, keyDown);
-      joyStatus &= ~0x10;
-      joyStatus |= keyDown << 4;
-      return 1;
+      bit = 4;
+      source = AUTOFIRE_KEYB_SHIFT;
+      break;
+    default:
+      return 0;
+  }
+  if (keyboardJoyMode == JOY_MODE_PORT1) {
+    // Port 1 goes through the keyboard matrix
+    ckey.setJoy1((ckey.joy1State & ~(1 << bit)) | (keyDown << bit));
+  } else if (bit == 4) {
+    // Button pin is driven by the autofire engine
+    autofire_hold(source, keyDown);
+  } else {
+    joymix_set(JOYMIX_KEYB, (joymix_get(JOYMIX_KEYB) & ~(1 << bit)) | keyDown << bit);
   }
-  return 0;
+  return 1;
 }
 
-static void handleButtons(uint32_t k) {
-  int button = !!(IR_GET_BUTTON1(k) || IR_GET_BUTTON2(k));
-  setPin_(JOY_BUTTON_PIN, button);
-  joyStatus &= 0xf;
-  joyStatus |= button << 4;
+// Keyboard joystick directions and fire up on both ports
+static void releaseKeyboardJoy(void) {
+  ckey.setJoy1(0);
+  joymix_set(JOYMIX_KEYB, 0);
+  autofire_hold(AUTOFIRE_KEYB_SPACE, 0);
+  autofire_hold(AUTOFIRE_KEYB_SHIFT, 0);
 }
 
-static void handleJoystick(uint32_t k) {
-  int8_t x = IR_GET_JOY_X(k);
-  int8_t y = IR_GET_JOY_Y(k);
-  CLEAR_TIMEOUT();
-  joyStatus &= 0xf0;
-  if (y >= joyMoveLimit) {
-    setPin_(JOY_UP_PIN, 1);
-    setPin_(JOY_DOWN_PIN, 0);
-    SET_TIMEOUT();
-    joyStatus |= 1;
-    joyStatus &= ~2;
-  } else if (y <= -joyMoveLimit) {
-    setPin_(JOY_UP_PIN, 0);
-    setPin_(JOY_DOWN_PIN, 1);
-    joyStatus |= 2;
-    joyStatus &= ~1;
-    SET_TIMEOUT();
-  } else {
-    setPin_(JOY_UP_PIN, 0);
-    setPin_(JOY_DOWN_PIN, 0);
-    joyStatus &= ~3;
-  }
-  if (x <= -joyMoveLimit) {
-    setPin_(JOY_LEFT_PIN, 1);
-    setPin_(JOY_RIGHT_PIN, 0);
-    joyStatus |= 4;
-    joyStatus &= ~8;
-    SET_TIMEOUT();
-  } else if (x >= joyMoveLimit) {
-    setPin_(JOY_LEFT_PIN, 0);
-    setPin_(JOY_RIGHT_PIN, 1);
-    joyStatus |= 8;
-    joyStatus &= ~4;
+static void handleButtons(IREvent k) {
+  autofire_hold(AUTOFIRE_BUTTON1, k.button1());
+  autofire_hold(AUTOFIRE_BUTTON2, k.button2());
+}
+
+// Step remote button and keyboard fire key to the next autofire rate
+static void cycleAutofire(uint8_t source1, uint8_t source2) {
+  uint8_t i = 0;
+  while (i < sizeof(autofireRates) - 1 && autofireRates[i] != autofire_getRate(source1)) {
+    i++;
+  }
+  i = (i + 1) % sizeof(autofireRates);
+  autofire_setRate(source1, autofireRates[i]);
+  autofire_setRate(source2, autofireRates[i]);
+  if (ckey.debug) {
+    Serial.print("Autofire frames: ");
+    Serial.println(autofireRates[i]);
+  }
+}
+
+// k 0 releases the stick, decoded frames are never 0
+static void handleJoystick(IREvent k) {
+  if (!k.raw()) {
+    joyfilter_reset(&joyX);
+    joyfilter_reset(&joyY);
+  }
+  int8_t y = joyfilter_update(&joyY, k.joyY(), joyMoveLimit);
+  int8_t x = joyfilter_update(&joyX, k.joyX(), joyMoveLimit);
+  joymix_set(JOYMIX_STICK, (y > 0) | (y < 0) << 1 | (x < 0) << 2 | (x > 0) << 3);
+  if (x || y) {
     SET_TIMEOUT();
   } else {
-    setPin_(JOY_LEFT_PIN, 0);
-    setPin_(JOY_RIGHT_PIN, 0);
-    joyStatus &= ~0x0c;
+    CLEAR_TIMEOUT();
+  }
+}
+
+// Modifier keys named in a repeat frame are still down, whichever key
+// the frame repeats
+static void renewModifiers(IREvent irData) {
+  static const uint8_t modifierKeys[][2] PROGMEM = {
+    {IR_MOD_SHIFT, IR_KC_L_SHIFT}, {IR_MOD_SHIFT, IR_KC_R_SHIFT},
+    {IR_MOD_ALT, IR_KC_L_ALT}, {IR_MOD_CTRL, IR_KC_L_CTRL},
+    {IR_MOD_GUI, IR_KC_L_GUI}, {IR_MOD_GUI, IR_KC_R_GUI},
+  };
+  for (uint8_t i = 0; i < sizeof(modifierKeys) / sizeof(modifierKeys[0]); i++) {
+    if (irData.modifier() & pgm_read_byte(&modifierKeys[i][0])) {
+      uint8_t kc = pgm_read_byte(&modifierKeys[i][1]);
+      ckey.renewLease(mapKey(IREvent::key(IR_EV_KEYBOARD, 0, kc)));
+    }
   }
 }
 
-static uint16_t mapKey(uint32_t irData) {
-  uint8_t kc = IR_GET_CODE(irData);
+static uint16_t mapKey(IREvent irData) {
+  uint8_t kc = irData.code();
   uint16_t c = CK_IGNORE_KEYCODE;
   int len = sizeof(C64Keymap_main) / sizeof(C64Keymap_main[0]);
   for (int i = 0; i < len; i++) {
@@ -275,67 +601,88 @@ static uint16_t mapKey(uint32_t irData) {
     uint8_t ckmKey = pgm_read_byte(&C64Keymap_main[i].ckmKey);
     uint8_t flags = pgm_read_byte(&C64Keymap_main[i].flags);
     if (irKey == kc) {
-      if (IR_GET_SHIFT(irData) && (flags & IR_SHIFT)) {
+      if (irData.shift() && (flags & IR_SHIFT)) {
         c = ckmKey;
         if (flags & CKM_SHIFT) {
           c |= FLAG_AUTOSHIFT;
         }
-        break;
-      } else if (!IR_GET_SHIFT(irData) && (flags & IR_NO_SHIFT)) {
+      } else if (!irData.shift() && (flags & IR_NO_SHIFT)) {
         c = ckmKey;
         if (flags & CKM_NO_SHIFT) {
           c |= FLAG_AUTOSHIFT;
         }
-        break;
+      } else {
+        continue;
+      }
+      if (flags & CKM_REPEAT) {
+        c |= FLAG_TYPEMATIC;
+      }
+      if (flags & CKM_MACRO) {
+        c |= FLAG_MACRO;
       }
+      break;
     }
   }
-  if (!IR_GET_RELEASE(irData)) {
+  if (!irData.release()) {
     c |= FLAG_KEYDOWN;
   }
   return c;
 }
 
-static void debugIRCode(uint32_t data) {
+static void debugReceivers(void) {
+  const irmerge_stats *stats = irmerge_getStats();
+  for (uint8_t r = 0; r < IR_RECEIVERS; r++) {
+    Serial.print("IR");
+    Serial.print(r + 1);
+    Serial.print(" decoded ");
+    Serial.print(stats->decoded[r]);
+    Serial.print(" first ");
+    Serial.println(stats->first[r]);
+  }
+  Serial.print("IR duplicates ");
+  Serial.println(stats->duplicates);
+}
+
+static void debugIRCode(IREvent data) {
   Serial.print("IR: 0x");
-  Serial.print(data, HEX);
-  if (IR_GET_KEYBOARD(data)) {
+  Serial.print(data.raw(), HEX);
+  if (data.isKeyboard()) {
     Serial.print(" key: 0x");
-    Serial.print(IR_GET_CODE(data), HEX);
+    Serial.print(data.code(), HEX);
     Serial.print(" '");
-    Serial.print(key2sym(IR_GET_CODE(data)));
+    Serial.print(key2sym(data.code()));
     Serial.print("' ");
 
     Serial.print("+KEY");
-    if (IR_GET_RELEASE(data)) {
+    if (data.release()) {
       Serial.print("+RELEASE");
     }
-    if (IR_GET_REPEAT(data)) {
+    if (data.repeat()) {
       Serial.print("+REPEAT");
     }
-    if (IR_GET_SHIFT(data)) {
+    if (data.shift()) {
       Serial.print("+SHIFT");
     }
-    if (IR_GET_ALT(data)) {
+    if (data.alt()) {
       Serial.print("+ALT");
     }
-    if (IR_GET_CTRL(data)) {
+    if (data.ctrl()) {
       Serial.print("+CTRL");
     }
-    if (IR_GET_GUI(data)) {
+    if (data.gui()) {
       Serial.print("+GUI");
     }
   } else {
     Serial.print(" joy ");
     Serial.print("x:");
-    Serial.print(IR_GET_JOY_X(data), DEC);
+    Serial.print(data.joyX(), DEC);
     Serial.print(" y:");
-    Serial.print(IR_GET_JOY_Y(data), DEC);
+    Serial.print(data.joyY(), DEC);
     Serial.print(" ");
-    if (IR_GET_BUTTON1(data)) {
+    if (data.button1()) {
       Serial.print("+BUTTON1");
     }
-    if (IR_GET_BUTTON2(data)) {
+    if (data.button2()) {
       Serial.print("+BUTTON2");
     }
   }
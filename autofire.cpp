@@ -0,0 +1,135 @@
+/*
+  autofire.cpp - Timer driven joystick button
+
+  Copyright (c) 2022 Jarkko Sonninen
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include <Arduino.h>
+
+#include "autofire.h"
+#include "trace.h"
+
+// Timer1 in CTC mode, prescaler 64. IRremote uses Timer2.
+#define AUTOFIRE_TIMER_TOP (F_CPU / 64 / AUTOFIRE_FRAME_HZ - 1)
+
+static int buttonPin;
+static uint8_t rates[AUTOFIRE_SOURCES];
+static volatile uint8_t held;
+static volatile uint16_t frame;
+static volatile uint8_t output;
+
+// value==1 means button pushed
+static void writeButton(uint8_t value) {
+  TRACE(TRACE_JOY, buttonPin, value);
+  if (value) {
+    pinMode(buttonPin, OUTPUT);
+    digitalWrite(buttonPin, LOW);
+  } else {
+    pinMode(buttonPin, INPUT_PULLUP);
+  }
+}
+
+static uint8_t autofireRunning(void) {
+  for (uint8_t i = 0; i < AUTOFIRE_SOURCES; i++) {
+    if ((held & (1 << i)) && rates[i]) {
+      return 1;
+    }
+  }
+  return 0;
+}
+
+static void update(void) {
+  uint8_t value = 0;
+  for (uint8_t i = 0; i < AUTOFIRE_SOURCES; i++) {
+    if (held & (1 << i)) {
+      // All sources share the frame counter, first frames are pushed
+      if (!rates[i] || !((frame / rates[i]) & 1)) {
+        value = 1;
+      }
+    }
+  }
+  if (value != output) {
+    output = value;
+    writeButton(value);
+  }
+}
+
+ISR(TIMER1_COMPA_vect) {
+  frame++;
+  update();
+}
+
+static void startTimer(void) {
+  TCCR1A = 0;
+  TCCR1B = 0;
+  TCNT1 = 0;
+  OCR1A = AUTOFIRE_TIMER_TOP;
+  TCCR1B = _BV(WGM12) | _BV(CS11) | _BV(CS10);
+  TIMSK1 |= _BV(OCIE1A);
+}
+
+static void stopTimer(void) {
+  TIMSK1 &= ~_BV(OCIE1A);
+  TCCR1B = 0;
+}
+
+void autofire_begin(int pin) {
+  buttonPin = pin;
+  held = 0;
+  output = 0;
+  stopTimer();
+}
+
+// Called with interrupts disabled after held or rates have changed
+static void restartTimer(uint8_t wasRunning) {
+  uint8_t running = autofireRunning();
+  if (running && !wasRunning) {
+    frame = 0;
+    startTimer();
+  } else if (!running && wasRunning) {
+    stopTimer();
+  }
+  update();
+}
+
+void autofire_setRate(uint8_t source, uint8_t frames) {
+  noInterrupts();
+  uint8_t wasRunning = autofireRunning();
+  rates[source] = frames;
+  restartTimer(wasRunning);
+  interrupts();
+}
+
+uint8_t autofire_getRate(uint8_t source) {
+  return rates[source];
+}
+
+void autofire_hold(uint8_t source, uint8_t value) {
+  noInterrupts();
+  uint8_t wasRunning = autofireRunning();
+  if (value) {
+    held |= 1 << source;
+  } else {
+    held &= ~(1 << source);
+  }
+  restartTimer(wasRunning);
+  interrupts();
+}
+
+uint8_t autofire_held(void) {
+  return held;
+}
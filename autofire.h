@@ -0,0 +1,43 @@
+/*
+  autofire.h - Timer driven joystick button
+
+  Copyright (c) 2022 Jarkko Sonninen
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef autofire_h
+#define autofire_h
+
+// Timer1 ticks at the C64 video frame rate (50 PAL, 60 NTSC)
+#define AUTOFIRE_FRAME_HZ 50
+
+// Sources that can hold the joystick button
+#define AUTOFIRE_BUTTON1 0    // Remote button 1
+#define AUTOFIRE_BUTTON2 1    // Remote button 2
+#define AUTOFIRE_KEYB_SPACE 2 // Space in keyboard joystick mode
+#define AUTOFIRE_KEYB_SHIFT 3 // Shift/ctrl in keyboard joystick mode
+#define AUTOFIRE_LEARNED 4    // Learned button of another remote
+#define AUTOFIRE_SOURCES 5
+
+void autofire_begin(int pin);
+// Button toggles every 'frames' frames while held. 0 means steady button.
+void autofire_setRate(uint8_t source, uint8_t frames);
+uint8_t autofire_getRate(uint8_t source);
+void autofire_hold(uint8_t source, uint8_t value);
+// Bit mask of sources holding the button
+uint8_t autofire_held(void);
+
+#endif
@@ -0,0 +1,87 @@
+/*
+  crashlog.cpp - Post-mortem event log in RAM kept over watchdog resets
+
+  Copyright (c) 2022 Jarkko Sonninen
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include <Arduino.h>
+#include <avr/wdt.h>
+
+#include "crashlog.h"
+
+crashlogHeader crashlog __attribute__((section(".noinit")));
+static uint8_t resetFlags __attribute__((section(".noinit")));
+
+#ifdef __AVR__
+// Runs before the C runtime. A watchdog reset leaves the watchdog on with
+// its shortest timeout, which would fire again before setup(). Optiboot
+// clears MCUSR and passes its value in r2.
+void crashlog_init3(void) __attribute__((naked, used, section(".init3")));
+void crashlog_init3(void) {
+  uint8_t flags = MCUSR;
+  if (!flags) {
+    asm volatile ("mov %0, r2" : "=r" (flags));
+  }
+  resetFlags = flags;
+  MCUSR = 0;
+  wdt_disable();
+}
+#endif
+
+static void printEntry(const crashlogEntry &e) {
+  Serial.print('!');
+  Serial.print((uint16_t)(crashlog.loops - e.loop));
+  Serial.print(' ');
+  Serial.print(e.kind);
+  Serial.print(' ');
+  Serial.print(e.id, HEX);
+  Serial.print(' ');
+  Serial.println(e.value, HEX);
+}
+
+void crashlog_begin(void) {
+#ifndef __AVR__
+  resetFlags = MCUSR;
+  MCUSR = 0;
+#endif
+  // RAM is random after power on
+  if (crashlog.magic != CRASHLOG_MAGIC || resetFlags & (_BV(PORF) | _BV(BORF))) {
+    crashlog.magic = CRASHLOG_MAGIC;
+    crashlog.resets = 0;
+    crashlog.events = 0;
+    crashlog.loops = 0;
+    crashlog.loopTime = 0;
+    return;
+  }
+  if (resetFlags & _BV(WDRF)) {
+    crashlog.resets++;
+    Serial.print(F("!W "));
+    Serial.print(crashlog.resets);
+    Serial.print(' ');
+    Serial.print(resetFlags, HEX);
+    Serial.print(' ');
+    Serial.print(crashlog.loops);
+    Serial.print(' ');
+    Serial.println(crashlog.loopTime);
+    uint16_t n = crashlog.events < CRASHLOG_ENTRIES ? crashlog.events : CRASHLOG_ENTRIES;
+    for (uint16_t i = crashlog.events - n; i != crashlog.events; i++) {
+      printEntry(crashlog.entries[i & (CRASHLOG_ENTRIES - 1)]);
+    }
+  }
+  crashlog.events = 0;
+  crashlog.loops = 0;
+}
@@ -0,0 +1,79 @@
+/*
+  crashlog.h - Post-mortem event log in RAM kept over watchdog resets
+
+  Copyright (c) 2022 Jarkko Sonninen
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef crashlog_h
+#define crashlog_h
+
+#include <stdint.h>
+#include <avr/io.h>
+#include <avr/interrupt.h>
+
+/* The last CRASHLOG_ENTRIES TRACE() events are kept in a ring in the
+ * .noinit section, which the C runtime does not clear at reset. Entries
+ * are stamped with the loop() count instead of the time, and the header
+ * has the count and millis() of the last loop(). After a watchdog reset
+ * crashlog_begin() prints the log on Serial before anything is traced:
+ *
+ *  !W <resets> <flags> <loops> <ms>  Watchdog reset, MCUSR and last loop()
+ *  !<loops before> <kind> <id> <value>  Entries as in trace.h, oldest first
+ */
+#define CRASHLOG_ENTRIES 16 // A power of two
+#define CRASHLOG_MAGIC 0xc64d
+
+struct crashlogEntry {
+  uint16_t loop;
+  char kind;
+  uint8_t id;
+  uint32_t value;
+};
+
+struct crashlogHeader {
+  uint16_t magic;
+  uint8_t resets;   // Watchdog resets since power on
+  uint16_t events;  // Entries ever written, the ring index in the low bits
+  uint16_t loops;
+  uint32_t loopTime;
+  crashlogEntry entries[CRASHLOG_ENTRIES];
+};
+
+extern crashlogHeader crashlog;
+
+// Call first in setup(), after Serial.begin()
+void crashlog_begin(void);
+
+// A few cycles, also from interrupts
+static inline void crashlog_event(char kind, uint8_t id, uint32_t value) {
+  uint8_t sreg = SREG;
+  cli();
+  crashlogEntry &e = crashlog.entries[crashlog.events++ & (CRASHLOG_ENTRIES - 1)];
+  e.loop = crashlog.loops;
+  e.kind = kind;
+  e.id = id;
+  e.value = value;
+  SREG = sreg;
+}
+
+// Call from loop() before wdt_reset()
+static inline void crashlog_loop(uint32_t now) {
+  crashlog.loops++;
+  crashlog.loopTime = now;
+}
+
+#endif
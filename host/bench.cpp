@@ -0,0 +1,398 @@
+/*
+  bench.cpp - Input latency and throughput benchmark on the virtual clock
+
+  Copyright (c) 2022 Jarkko Sonninen
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/* Every scenario runs in its own process from power on, so results do not
+ * depend on the order of scenarios. Time is virtual and the CPU cost model
+ * of the HAL is on, so the numbers are deterministic and comparable
+ * between commits.
+ *
+ * Latency is measured from the end of the IR frame on air to the matrix
+ * crosspoint strobe or joystick pin change it caused. It includes the
+ * 5 ms gap IRremote needs to detect the end of a frame.
+ *
+ * sleep% is the share of time loop() spent in sleep_cpu() and wake_us the
+ * longest time from a captured IR frame to its decode.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <algorithm>
+#include <deque>
+#include <vector>
+
+#include <IRremote.h>
+
+#include "hal.h"
+#include "../C64keyboard.hpp"
+#include "../irkey.h"
+#include "../mapping.h"
+
+extern C64keyboard ckey;
+
+// Gap between frames on air. IRremote needs 5 ms of silence to end a frame.
+#define BENCH_FRAME_GAP_US (GAP_TICKS * MICROS_PER_TICK + 1000)
+
+struct expect {
+  uint32_t frameEnd_us;
+  uint8_t code;
+  uint8_t state;
+};
+
+static std::deque<expect> expected;
+static std::vector<uint32_t> latencies;
+static uint8_t lastSwitchState[8];
+static uint8_t lastJoyLevel[NUM_DIGITAL_PINS];
+static std::deque<uint32_t> joyFrameEnd_us;
+static uint32_t gpioOps;
+static uint32_t ledOps;
+static uint32_t events;
+static uint32_t senderTime_us;
+static uint32_t airFree_us;
+
+static const uint8_t joyPins[] = {A0, A1, A2, A3, A4};
+
+static bool isJoyPin(uint8_t pin) {
+  return pin >= A0 && pin <= A4;
+}
+
+static void onGpio(const hal_gpio_op &op) {
+  if (op.pin == LED_BUILTIN) {
+    ledOps++;
+    return;
+  }
+  gpioOps++;
+  if (op.pin == ANALOG_SW_STROBE && op.op == HAL_OP_WRITE && op.value) {
+    // switchState is updated before the strobe
+    for (uint8_t b = 0; b < 8; b++) {
+      uint8_t changed = ckey.switchState[b] ^ lastSwitchState[b];
+      for (uint8_t a = 0; a < 8; a++) {
+        if (!(changed & (1 << a))) {
+          continue;
+        }
+        uint8_t code = a << 3 | b;
+        uint8_t state = (ckey.switchState[b] >> a) & 1;
+        for (std::deque<expect>::iterator it = expected.begin(); it != expected.end(); ++it) {
+          if (it->code == code && it->state == state) {
+            latencies.push_back(op.time_us - it->frameEnd_us);
+            expected.erase(it);
+            break;
+          }
+        }
+      }
+      lastSwitchState[b] = ckey.switchState[b];
+    }
+  }
+  if (isJoyPin(op.pin)) {
+    uint8_t level = hal_pin_level(op.pin);
+    if (level != lastJoyLevel[op.pin]) {
+      lastJoyLevel[op.pin] = level;
+      // Attributed to the latest joystick frame that has ended, changes
+      // without one are hold timeouts
+      uint32_t end = 0;
+      while (!joyFrameEnd_us.empty() && joyFrameEnd_us.front() <= op.time_us) {
+        end = joyFrameEnd_us.front();
+        joyFrameEnd_us.pop_front();
+      }
+      if (end) {
+        latencies.push_back(op.time_us - end);
+      }
+    }
+  }
+}
+
+static void start(void) {
+  hal_reset();
+  hal_cpu_model(1);
+  setup();
+  memcpy(lastSwitchState, ckey.switchState, sizeof(lastSwitchState));
+  for (uint8_t i = 0; i < sizeof(joyPins); i++) {
+    lastJoyLevel[joyPins[i]] = hal_pin_level(joyPins[i]);
+  }
+  hal_gpio_hook(onGpio);
+  hal_run_until_us(100000);
+  senderTime_us = airFree_us = hal_time_us();
+}
+
+// Send a frame 'spacing' after the start of the previous one, or as soon
+// as the air is free
+static uint32_t sendMinSpacing(const std::vector<uint16_t> &ticks, uint32_t spacing_us) {
+  uint32_t at = senderTime_us + spacing_us;
+  if ((int32_t)(airFree_us - at) > 0) {
+    at = airFree_us;
+  }
+  hal_run_until_us(at);
+  uint32_t end = hal_time_us() + hal_ir_frame_us(ticks);
+  hal_ir_raw(ticks);
+  senderTime_us = hal_time_us();
+  airFree_us = end + BENCH_FRAME_GAP_US;
+  events++;
+  return end;
+}
+
+static void sendKey(uint8_t irKey, uint8_t ckm, uint8_t release, uint8_t repeat, uint32_t spacing_us) {
+  uint8_t header = IR_EV_KEYBOARD | (release ? IR_EV_RELEASE : 0) | (repeat ? IR_EV_REPEAT : 0);
+  uint32_t ev = IREvent::key(header, 0, irKey).raw();
+  uint32_t end = sendMinSpacing(hal_ir_keyboard_ticks(ev), spacing_us);
+  if (!repeat) {
+    expect e = {end, ckm, (uint8_t)!release};
+    expected.push_back(e);
+  }
+}
+
+// Ambient light: a lone spike before the frame, a spike in the header
+// space and a dropout in the first bit mark of the frame
+static void sendNoisyKey(uint8_t irKey, uint8_t ckm, uint8_t release, uint32_t spacing_us) {
+  hal_run_until_us(airFree_us);
+  hal_ir_raw(std::vector<uint16_t>(1, 1));
+  airFree_us = hal_time_us() + MICROS_PER_TICK + BENCH_FRAME_GAP_US;
+  uint8_t header = IR_EV_KEYBOARD | (release ? IR_EV_RELEASE : 0);
+  uint32_t ev = IREvent::key(header, 0, irKey).raw();
+  std::vector<uint16_t> ticks = hal_ir_keyboard_ticks(ev);
+  uint16_t space = ticks[1];
+  uint16_t mark = ticks[2];
+  static const uint16_t split[] = {4, 1, 0, 5, 1, 0};
+  std::vector<uint16_t> noisy(split, split + 6);
+  noisy[2] = space - 5;
+  noisy[5] = mark - 6;
+  ticks.erase(ticks.begin() + 1, ticks.begin() + 3);
+  ticks.insert(ticks.begin() + 1, noisy.begin(), noisy.end());
+  uint32_t end = sendMinSpacing(ticks, spacing_us);
+  expect e = {end, ckm, (uint8_t)!release};
+  expected.push_back(e);
+}
+
+static void sendJoy(int8_t x, int8_t y, uint8_t b1, uint32_t spacing_us) {
+  joyFrameEnd_us.push_back(sendMinSpacing(hal_ir_joystick_ticks(x, y, b1, 0), spacing_us));
+}
+
+static const uint8_t letters[][2] = {
+  {IR_KC_A, CKM_A}, {IR_KC_B, CKM_B}, {IR_KC_C, CKM_C}, {IR_KC_D, CKM_D},
+  {IR_KC_E, CKM_E}, {IR_KC_F, CKM_F}, {IR_KC_G, CKM_G}, {IR_KC_H, CKM_H},
+  {IR_KC_I, CKM_I}, {IR_KC_J, CKM_J}, {IR_KC_K, CKM_K}, {IR_KC_L, CKM_L},
+  {IR_KC_M, CKM_M}, {IR_KC_N, CKM_N}, {IR_KC_O, CKM_O}, {IR_KC_P, CKM_P},
+};
+#define LETTERS (sizeof(letters) / sizeof(letters[0]))
+
+#ifdef PS2_CLOCK_PIN
+// Set 2 scan codes of the letters above
+static const uint8_t ps2Letters[LETTERS] = {
+  0x1c, 0x32, 0x21, 0x23, 0x24, 0x2b, 0x34, 0x33,
+  0x43, 0x3b, 0x42, 0x4b, 0x3a, 0x31, 0x44, 0x4d,
+};
+
+// Latency is measured from the last falling clock edge of the scan code
+static void sendPs2Key(uint8_t scancode, uint8_t ckm, uint8_t release, uint32_t spacing_us) {
+  std::vector<uint8_t> bytes;
+  if (release) {
+    bytes.push_back(0xf0);
+  }
+  bytes.push_back(scancode);
+  hal_run_until_us(senderTime_us + spacing_us);
+  senderTime_us = hal_time_us();
+  expect e = {hal_ps2(bytes), ckm, (uint8_t)!release};
+  expected.push_back(e);
+  events++;
+}
+#endif
+
+// Scenarios, spacing is time between frames
+
+static void typing(uint32_t spacing_us, int keys) {
+  for (int i = 0; i < keys; i++) {
+    const uint8_t *k = letters[i % LETTERS];
+    sendKey(k[0], k[1], 0, 0, spacing_us);
+    sendKey(k[0], k[1], 1, 0, spacing_us);
+  }
+}
+
+static void scenarioTyping(void) {
+  typing(30000, 100);
+}
+
+static void scenarioHeld(void) {
+  for (int i = 0; i < 10; i++) {
+    const uint8_t *k = letters[i % LETTERS];
+    sendKey(k[0], k[1], 0, 0, 40000);
+    for (int r = 0; r < 8; r++) {
+      sendKey(k[0], k[1], 0, 1, 110000);
+    }
+    sendKey(k[0], k[1], 1, 0, 110000);
+  }
+}
+
+// A held while SPACE is tapped for 2 s. The keyboard repeats only the
+// last key pressed, so A gets no repeat frames after the first tap.
+static void scenarioHeldTap(void) {
+  sendKey(IR_KC_A, CKM_A, 0, 0, 40000);
+  sendKey(IR_KC_A, CKM_A, 0, 1, 110000);
+  for (int i = 0; i < 7; i++) {
+    sendKey(IR_KC_SPACE, CKM_SPACE, 0, 0, 110000);
+    sendKey(IR_KC_SPACE, CKM_SPACE, 0, 1, 110000);
+    sendKey(IR_KC_SPACE, CKM_SPACE, 1, 0, 110000);
+  }
+  sendKey(IR_KC_A, CKM_A, 1, 0, 110000);
+}
+
+static void scenarioStick(void) {
+  for (int i = 0; i < 200; i++) {
+    int t = (i * 16) % 512;
+    int x = t < 256 ? t - 128 : 383 - t;
+    sendJoy(x, -x, 0, 25000);
+  }
+  sendJoy(0, 0, 0, 25000);
+}
+
+// Stick held near the default move limit of 16 with sensor noise
+static void scenarioJitter(void) {
+  static const int8_t noise[] = {16, 12, 20, 12, 16, 8, 20, 16};
+  for (int i = 0; i < 200; i++) {
+    sendJoy(noise[i % sizeof(noise)], 0, 0, 25000);
+  }
+  sendJoy(0, 0, 0, 25000);
+}
+
+static void scenarioMixed(void) {
+  for (int i = 0; i < 50; i++) {
+    const uint8_t *k = letters[i % LETTERS];
+    sendKey(k[0], k[1], 0, 0, 15000);
+    sendJoy(i & 1 ? 100 : -100, 0, 0, 15000);
+    sendKey(k[0], k[1], 1, 0, 15000);
+    sendJoy(0, 0, 0, 15000);
+  }
+}
+
+static void scenarioNoisy(void) {
+  for (int i = 0; i < 100; i++) {
+    const uint8_t *k = letters[i % LETTERS];
+    sendNoisyKey(k[0], k[1], 0, 40000);
+    sendNoisyKey(k[0], k[1], 1, 40000);
+  }
+}
+
+#ifdef PS2_CLOCK_PIN
+static void scenarioPs2(void) {
+  for (int i = 0; i < 100; i++) {
+    sendPs2Key(ps2Letters[i % LETTERS], letters[i % LETTERS][1], 0, 30000);
+    sendPs2Key(ps2Letters[i % LETTERS], letters[i % LETTERS][1], 1, 30000);
+  }
+}
+#endif
+
+struct scenario {
+  const char *name;
+  void (*run)(void);
+};
+
+static const scenario scenarios[] = {
+  {"typing_fast", scenarioTyping},
+  {"held_repeat", scenarioHeld},
+  {"held_tap", scenarioHeldTap},
+  {"stick_sweep", scenarioStick},
+  {"stick_jitter", scenarioJitter},
+  {"mixed", scenarioMixed},
+  {"noisy_light", scenarioNoisy},
+#ifdef PS2_CLOCK_PIN
+  {"ps2_typing", scenarioPs2},
+#endif
+};
+
+static uint32_t percentile(std::vector<uint32_t> &v, int p) {
+  if (v.empty()) {
+    return 0;
+  }
+  size_t i = (v.size() - 1) * p / 100;
+  return v[i];
+}
+
+static void finish(void) {
+  // Let the last frames through
+  hal_run_until_us(hal_time_us() + 300000);
+  hal_gpio_hook(NULL);
+}
+
+static void report(const char *name) {
+  std::sort(latencies.begin(), latencies.end());
+  double secs = hal_time_us() / 1e6;
+  printf("%-14s %6u %7u %6u %7u %7u %7u %7u %7.1f %7.0f %6.1f %7u\n", name, events,
+    hal_ir_dropped(), (unsigned)expected.size(),
+    percentile(latencies, 50), percentile(latencies, 90),
+    percentile(latencies, 99), latencies.empty() ? 0 : latencies.back(),
+    events ? (double)gpioOps / events : 0.0, ledOps / secs,
+    hal_sleep_us() * 100.0 / hal_time_us(), hal_ir_service_max_us());
+}
+
+// Run in a child process so that every run starts from power on
+static int runChild(void (*fn)(void *), void *arg) {
+  fflush(stdout);
+  pid_t pid = fork();
+  if (pid == 0) {
+    fn(arg);
+    fflush(stdout);
+    _exit(0);
+  }
+  int status;
+  waitpid(pid, &status, 0);
+  return WIFEXITED(status) ? WEXITSTATUS(status) : 255;
+}
+
+static void runScenario(void *arg) {
+  const scenario *s = (const scenario *)arg;
+  start();
+  s->run();
+  finish();
+  report(s->name);
+}
+
+// Exit status 0 if every event of the typing scenario got through
+static void runRate(void *arg) {
+  uint32_t rate = *(uint32_t *)arg;
+  start();
+  typing(1000000 / rate, 50);
+  finish();
+  _exit(hal_ir_dropped() || !expected.empty() ? 1 : 0);
+}
+
+int main(int argc, char **argv) {
+  (void)argc;
+  (void)argv;
+  printf("# cirkjoy_bench virtual clock, loop step %u us, cpu model on\n", HAL_LOOP_STEP_US);
+  printf("%-14s %6s %7s %6s %7s %7s %7s %7s %7s %7s %6s %7s\n", "scenario", "events",
+    "dropped", "missed", "p50_us", "p90_us", "p99_us", "max_us", "gpio/ev", "led/s",
+    "sleep%", "wake_us");
+  for (size_t i = 0; i < sizeof(scenarios) / sizeof(scenarios[0]); i++) {
+    runChild(runScenario, (void *)&scenarios[i]);
+  }
+
+  // Highest typing rate without dropped or lost events. The rate is
+  // limited by frame time on air when the firmware keeps up.
+  std::vector<uint16_t> frame = hal_ir_keyboard_ticks(IREvent::key(IR_EV_KEYBOARD, 0, IR_KC_A).raw());
+  uint32_t airRate = 1000000 / (hal_ir_frame_us(frame) + BENCH_FRAME_GAP_US);
+  uint32_t sustained = 0;
+  for (uint32_t rate = 5; rate <= airRate; rate += 5) {
+    if (runChild(runRate, &rate) != 0) {
+      break;
+    }
+    sustained = rate;
+  }
+  printf("max_rate_ev_s %u air_limit_ev_s %u\n", sustained, airRate);
+  return 0;
+}
@@ -0,0 +1,3 @@
+// The sketch is plain C++ once Arduino.h is included
+#include <Arduino.h>
+#include "../CIRKJOY.ino"
@@ -0,0 +1,219 @@
+/*
+  diversity.cpp - Two IR receivers with simulated frame loss
+
+  Copyright (c) 2022 Jarkko Sonninen
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/* Sends keyboard frames to the two receivers with per-receiver drop
+ * patterns and reports what the merge stage made of them. Every frame
+ * that reaches at least one receiver must come through once, and the
+ * latency must not depend on which receiver got it.
+ *
+ * unseen: frames neither receiver got
+ * lost: frames some receiver got but that were not delivered
+ * dup: frames merged as duplicates
+ * missed: expected matrix changes that did not happen
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <algorithm>
+#include <deque>
+#include <vector>
+
+#include <IRremote.h>
+
+#include "hal.h"
+#include "../C64keyboard.hpp"
+#include "../irkey.h"
+#include "../irmerge.h"
+#include "../mapping.h"
+
+extern C64keyboard ckey;
+
+#define DIVERSITY_FRAMES 400
+#define DIVERSITY_SPACING_US 40000
+
+struct expect {
+  uint32_t frameEnd_us;
+  uint8_t code;
+  uint8_t state;
+};
+
+static std::deque<expect> expected;
+static std::vector<uint32_t> latencies;
+static uint8_t lastSwitchState[8];
+static uint32_t seed;
+
+// Deterministic, the same drops on every run
+static uint32_t random32(void) {
+  seed = seed * 1103515245UL + 12345;
+  return seed >> 8;
+}
+
+static uint8_t drop(uint8_t percent) {
+  return random32() % 100 < percent;
+}
+
+static uint8_t patternBoth(int i) {
+  (void)i;
+  return HAL_IR_ALL;
+}
+
+static uint8_t patternRx1Only(int i) {
+  (void)i;
+  return HAL_IR_RX1;
+}
+
+static uint8_t patternRx2Only(int i) {
+  (void)i;
+  return HAL_IR_RX2;
+}
+
+static uint8_t patternRx1Shadowed(int i) {
+  (void)i;
+  return HAL_IR_RX2 | (drop(30) ? 0 : HAL_IR_RX1);
+}
+
+static uint8_t patternEach30(int i) {
+  (void)i;
+  return (drop(30) ? 0 : HAL_IR_RX1) | (drop(30) ? 0 : HAL_IR_RX2);
+}
+
+// Receivers are shadowed in turns, five frames each
+static uint8_t patternBursts(int i) {
+  return (i / 5) & 1 ? HAL_IR_RX1 : HAL_IR_RX2;
+}
+
+struct pattern {
+  const char *name;
+  uint8_t (*receivers)(int i);
+};
+
+static const pattern patterns[] = {
+  {"both", patternBoth},
+  {"rx1_only", patternRx1Only},
+  {"rx2_only", patternRx2Only},
+  {"rx1_drop30", patternRx1Shadowed},
+  {"each_drop30", patternEach30},
+  {"bursts", patternBursts},
+};
+
+static const uint8_t letters[][2] = {
+  {IR_KC_A, CKM_A}, {IR_KC_B, CKM_B}, {IR_KC_C, CKM_C}, {IR_KC_D, CKM_D},
+  {IR_KC_E, CKM_E}, {IR_KC_F, CKM_F}, {IR_KC_G, CKM_G}, {IR_KC_H, CKM_H},
+};
+#define LETTERS (sizeof(letters) / sizeof(letters[0]))
+
+static void onGpio(const hal_gpio_op &op) {
+  if (op.pin != ANALOG_SW_STROBE || op.op != HAL_OP_WRITE || !op.value) {
+    return;
+  }
+  for (uint8_t b = 0; b < 8; b++) {
+    uint8_t changed = ckey.switchState[b] ^ lastSwitchState[b];
+    for (uint8_t a = 0; a < 8; a++) {
+      if (!(changed & (1 << a))) {
+        continue;
+      }
+      uint8_t code = a << 3 | b;
+      uint8_t state = (ckey.switchState[b] >> a) & 1;
+      for (std::deque<expect>::iterator it = expected.begin(); it != expected.end(); ++it) {
+        if (it->code == code && it->state == state) {
+          latencies.push_back(op.time_us - it->frameEnd_us);
+          expected.erase(it);
+          break;
+        }
+      }
+    }
+    lastSwitchState[b] = ckey.switchState[b];
+  }
+}
+
+static void run(const pattern *p) {
+  hal_reset();
+  hal_cpu_model(1);
+  setup();
+  memcpy(lastSwitchState, ckey.switchState, sizeof(lastSwitchState));
+  hal_gpio_hook(onGpio);
+  seed = 1;
+
+  uint32_t sent = 0;
+  uint32_t reachable = 0;
+  // Matrix state the frames that got through should leave. Keys whose
+  // release was lost are released later by their lease, those changes
+  // are not expected.
+  uint8_t pressed[64] = {};
+  uint32_t t = 100000;
+  for (int i = 0; i < DIVERSITY_FRAMES; i++) {
+    const uint8_t *k = letters[(i / 2) % LETTERS];
+    uint8_t release = i & 1;
+    uint8_t rx = p->receivers(i);
+    hal_run_until_us(t);
+    uint8_t header = IR_EV_KEYBOARD | (release ? IR_EV_RELEASE : 0);
+    std::vector<uint16_t> ticks = hal_ir_keyboard_ticks(IREvent::key(header, 0, k[0]).raw());
+    uint32_t end = hal_time_us() + hal_ir_frame_us(ticks);
+    hal_ir_raw(ticks, rx);
+    sent++;
+    if (rx) {
+      reachable++;
+      if (pressed[k[1]] == release) {
+        expect e = {end, k[1], (uint8_t)!release};
+        expected.push_back(e);
+      }
+      pressed[k[1]] = !release;
+    }
+    t += DIVERSITY_SPACING_US;
+  }
+  hal_run_until_us(t + 300000);
+  hal_gpio_hook(NULL);
+
+  const irmerge_stats *s = irmerge_getStats();
+  uint32_t delivered = s->first[0] + s->first[1];
+  std::sort(latencies.begin(), latencies.end());
+  printf("%-12s %5u %6u %6u %6u %9u %4u %4u %6u %7u %7u\n", p->name, sent,
+    s->decoded[0], s->decoded[1], sent - reachable, delivered,
+    reachable - delivered, s->duplicates, (unsigned)expected.size(),
+    latencies.empty() ? 0 : latencies[latencies.size() / 2],
+    latencies.empty() ? 0 : latencies.back());
+}
+
+// Run in a child process so that every run starts from power on
+static void runChild(const pattern *p) {
+  fflush(stdout);
+  pid_t pid = fork();
+  if (pid == 0) {
+    run(p);
+    fflush(stdout);
+    _exit(0);
+  }
+  waitpid(pid, NULL, 0);
+}
+
+int main(int argc, char **argv) {
+  (void)argc;
+  (void)argv;
+  printf("# %d keyboard frames every %d us, merge window %d us\n", DIVERSITY_FRAMES,
+    DIVERSITY_SPACING_US, IR_MERGE_WINDOW_US);
+  printf("%-12s %5s %6s %6s %6s %9s %4s %4s %6s %7s %7s\n", "pattern", "sent",
+    "rx1_ok", "rx2_ok", "unseen", "delivered", "lost", "dup", "missed", "p50_us", "max_us");
+  for (size_t i = 0; i < sizeof(patterns) / sizeof(patterns[0]); i++) {
+    runChild(&patterns[i]);
+  }
+  return 0;
+}
@@ -0,0 +1,848 @@
+/*
+  hal.cpp - Host hardware abstraction for running the firmware natively
+
+  Copyright (c) 2022 Jarkko Sonninen
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include <stdio.h>
+#include <deque>
+
+#include <Arduino.h>
+#include <IRremote.h>
+#include <avr/wdt.h>
+#include <avr/eeprom.h>
+#include <avr/sleep.h>
+
+#include "hal.h"
+
+// Interrupt vectors defined by the firmware, if any
+extern "C" void TIMER1_COMPA_vect(void) __attribute__((weak));
+extern "C" void PCINT0_vect(void) __attribute__((weak));
+extern "C" void ANALOG_COMP_vect(void) __attribute__((weak));
+
+HardwareSerial Serial;
+volatile irparams_t irparams;
+
+volatile uint8_t TCCR1A;
+volatile uint8_t TCCR1B;
+volatile uint16_t TCNT1;
+volatile uint16_t OCR1A;
+volatile uint8_t TIMSK1;
+volatile uint8_t SREG;
+volatile uint8_t PCICR;
+volatile uint8_t PCMSK0;
+volatile uint8_t ACSR;
+volatile uint8_t ADCSRA;
+volatile uint8_t ADCSRB;
+volatile uint8_t ADMUX;
+volatile uint8_t MCUSR;
+
+struct pin_edge {
+  uint32_t time_us;
+  uint8_t level;
+};
+
+struct line_edge {
+  uint32_t time_us;
+  uint8_t pin;
+  uint8_t level;
+};
+
+struct ir_frame {
+  uint32_t start_us;
+  uint32_t end_us;
+  uint8_t accepted;
+  std::vector<uint16_t> ticks;
+};
+
+static uint32_t now_us;
+static uint8_t cpuModel;
+static uint32_t cpuDebt_us;
+static uint8_t pinModes[NUM_DIGITAL_PINS];
+static uint8_t pinValues[NUM_DIGITAL_PINS];
+static uint8_t pinInputs[NUM_DIGITAL_PINS];
+static std::vector<hal_gpio_op> gpioLog;
+static void (*gpioHook)(const hal_gpio_op &op);
+static std::deque<uint8_t> serialIn;
+static std::string serialOut;
+static std::deque<ir_frame> irFrames;
+static std::deque<pin_edge> ir2Edges;
+static std::deque<line_edge> lineEdges;
+static void (*extIsr[2])(void);
+static int extMode[2];
+static uint32_t irDropped;
+static uint32_t irLastEnd_us;
+static uint32_t irCaptured_us;
+static uint32_t irServiceMax_us;
+static uint8_t eeprom[E2END + 1];
+static uint8_t timer1Running;
+static uint32_t timer1Next_us;
+static uint8_t wdtEnabled;
+static uint32_t wdtTimeout_us;
+static uint32_t wdtLast_us;
+static uint32_t wdtExpired;
+static uint8_t sleepEnabled;
+static uint8_t sleeping;
+static uint32_t sleep_us;
+
+// Time helpers
+
+uint32_t hal_time_us(void) {
+  return now_us;
+}
+
+void hal_cpu_model(uint8_t enable) {
+  cpuModel = enable;
+  cpuDebt_us = 0;
+}
+
+static void charge(uint32_t us) {
+  if (cpuModel) {
+    cpuDebt_us += us;
+  }
+}
+
+uint32_t hal_cpu_time_us(void) {
+  return now_us + cpuDebt_us;
+}
+
+static uint32_t timer1Period_us(void) {
+  static const uint16_t prescaler[] = {0, 1, 8, 64, 256, 1024, 0, 0};
+  uint16_t p = prescaler[TCCR1B & 7];
+  return (uint32_t)(OCR1A + 1) * p / (F_CPU / 1000000UL);
+}
+
+static void deliverIR(void) {
+  while (!irFrames.empty()) {
+    ir_frame &f = irFrames.front();
+    if (f.start_us <= now_us && !f.accepted) {
+      // The receiver ignores input until resume() after a captured frame
+      f.accepted = irparams.rcvstate != STATE_STOP ? 1 : 2;
+    }
+    // Capture ends when the receiver sees the gap after the last mark
+    if (f.end_us + GAP_TICKS * MICROS_PER_TICK > now_us) {
+      break;
+    }
+    if (f.accepted == 1 && irparams.rcvstate != STATE_STOP) {
+      uint32_t gap = (f.start_us - irLastEnd_us) / MICROS_PER_TICK;
+      irparams.rawbuf[0] = gap > 0x7fff ? 0x7fff : gap;
+      int len = 1;
+      for (size_t i = 0; i < f.ticks.size() && len < RAW_BUFFER_LENGTH; i++) {
+        irparams.rawbuf[len++] = f.ticks[i];
+      }
+      irparams.rawlen = len;
+      irparams.overflow = f.ticks.size() + 1 > RAW_BUFFER_LENGTH;
+      irparams.rcvstate = STATE_STOP;
+      irCaptured_us = f.end_us + GAP_TICKS * MICROS_PER_TICK;
+    } else {
+      irDropped++;
+    }
+    irLastEnd_us = f.end_us;
+    irFrames.pop_front();
+  }
+}
+
+// Edges on the second receiver pin, with pin change interrupts
+static void deliverIR2(void) {
+#ifdef IR2_RECEIVE_PIN
+  while (!ir2Edges.empty() && ir2Edges.front().time_us <= now_us) {
+    uint8_t level = ir2Edges.front().level;
+    ir2Edges.pop_front();
+    if (pinInputs[IR2_RECEIVE_PIN] == level) {
+      continue;
+    }
+    pinInputs[IR2_RECEIVE_PIN] = level;
+    if ((PCICR & _BV(PCIE0)) && (PCMSK0 & _BV(IR2_RECEIVE_PIN - 8)) && PCINT0_vect) {
+      PCINT0_vect();
+    }
+  }
+#endif
+}
+
+// The comparator sees A7 with the bandgap on AIN+ and ADC7 on AIN-, so
+// its output is high while the line is low
+static uint8_t comparatorOnA7(void) {
+  return (ACSR & _BV(ACBG)) && !(ADCSRA & _BV(ADEN)) && (ADCSRB & _BV(ACME)) && (ADMUX & 0x0f) == 7;
+}
+
+static void comparatorEdge(uint8_t level) {
+  if (!comparatorOnA7()) {
+    return;
+  }
+  if (level) {
+    ACSR &= ~_BV(ACO);
+  } else {
+    ACSR |= _BV(ACO);
+  }
+  uint8_t mode = ACSR & (_BV(ACIS1) | _BV(ACIS0));
+  uint8_t out = !level;
+  if ((ACSR & _BV(ACIE)) && ANALOG_COMP_vect
+      && (mode == 0 || (mode == _BV(ACIS1) && !out) || (mode == (_BV(ACIS1) | _BV(ACIS0)) && out))) {
+    ANALOG_COMP_vect();
+  }
+}
+
+// Edges on other input lines, with INT0 and INT1 external interrupts and
+// the analog comparator on A7
+static void deliverLines(void) {
+  while (!lineEdges.empty() && lineEdges.front().time_us <= now_us) {
+    line_edge e = lineEdges.front();
+    lineEdges.pop_front();
+    if (pinInputs[e.pin] == e.level) {
+      continue;
+    }
+    pinInputs[e.pin] = e.level;
+    if (e.pin == PIN_A7) {
+      comparatorEdge(e.level);
+      continue;
+    }
+    int i = digitalPinToInterrupt(e.pin);
+    if (i < 0 || !extIsr[i]) {
+      continue;
+    }
+    if (extMode[i] == CHANGE || (extMode[i] == FALLING && !e.level) || (extMode[i] == RISING && e.level)) {
+      extIsr[i]();
+    }
+  }
+}
+
+// Next edge that wakes the CPU from sleep
+static uint32_t nextInterrupt_us(uint32_t limit) {
+  for (size_t i = 0; i < lineEdges.size() && lineEdges[i].time_us < limit; i++) {
+    int n = digitalPinToInterrupt(lineEdges[i].pin);
+    if ((n >= 0 && extIsr[n]) || (lineEdges[i].pin == PIN_A7 && (ACSR & _BV(ACIE)))) {
+      return lineEdges[i].time_us;
+    }
+  }
+  return limit;
+}
+
+void hal_advance_us(uint32_t us) {
+  uint32_t target = now_us + us;
+  while (now_us != target) {
+    uint32_t next = target;
+    if (timer1Running && timer1Next_us < next) {
+      next = timer1Next_us;
+    }
+    if (!ir2Edges.empty() && ir2Edges.front().time_us < next) {
+      next = ir2Edges.front().time_us;
+    }
+    if (!lineEdges.empty() && lineEdges.front().time_us < next) {
+      next = lineEdges.front().time_us;
+    }
+    now_us = next;
+    deliverIR();
+    deliverIR2();
+    deliverLines();
+    if ((TIMSK1 & _BV(OCIE1A)) && (TCCR1B & 7)) {
+      if (!timer1Running) {
+        timer1Running = 1;
+        timer1Next_us = now_us + timer1Period_us();
+      } else if (now_us == timer1Next_us) {
+        timer1Next_us += timer1Period_us();
+        if (TIMER1_COMPA_vect) {
+          TIMER1_COMPA_vect();
+        }
+      }
+    } else {
+      timer1Running = 0;
+    }
+  }
+  if (wdtEnabled && now_us - wdtLast_us > wdtTimeout_us) {
+    wdtExpired++;
+    wdtLast_us = now_us;
+  }
+}
+
+void hal_run_until_us(uint32_t us) {
+  while ((int32_t)(us - now_us) > 0) {
+    sleeping = 0;
+    loop();
+    uint32_t step = us - now_us;
+    uint32_t wake = sleeping ? MICROS_PER_TICK - now_us % MICROS_PER_TICK : HAL_LOOP_STEP_US;
+    if (sleeping) {
+      wake = nextInterrupt_us(now_us + wake) - now_us;
+    }
+    if (step > wake) {
+      step = wake;
+    }
+    // A slow loop() iteration delays the next one
+    if (cpuDebt_us > step) {
+      step = cpuDebt_us;
+    }
+    if (sleeping) {
+      sleep_us += step - cpuDebt_us;
+    }
+    cpuDebt_us = 0;
+    hal_advance_us(step);
+  }
+}
+
+uint32_t hal_sleep_us(void) {
+  return sleep_us;
+}
+
+void hal_reset(void) {
+  now_us = 0;
+  memset(pinModes, INPUT, sizeof(pinModes));
+  memset(pinValues, LOW, sizeof(pinValues));
+  memset(pinInputs, HIGH, sizeof(pinInputs));
+  gpioLog.clear();
+  serialIn.clear();
+  serialOut.clear();
+  irFrames.clear();
+  ir2Edges.clear();
+  lineEdges.clear();
+  memset(extIsr, 0, sizeof(extIsr));
+  irDropped = 0;
+  irLastEnd_us = 0;
+  irparams.rcvstate = STATE_IDLE;
+  irparams.rawlen = 0;
+  memset(eeprom, 0xff, sizeof(eeprom));
+  TCCR1A = TCCR1B = TIMSK1 = 0;
+  TCNT1 = OCR1A = 0;
+  PCICR = PCMSK0 = 0;
+  ACSR = ADCSRB = ADMUX = 0;
+  ADCSRA = _BV(ADEN);
+  timer1Running = 0;
+  wdtEnabled = 0;
+  wdtExpired = 0;
+  cpuDebt_us = 0;
+  sleepEnabled = 0;
+  sleeping = 0;
+  sleep_us = 0;
+  irServiceMax_us = 0;
+  MCUSR = _BV(PORF);
+}
+
+void hal_restart(uint8_t mcusr) {
+  uint8_t saved[sizeof(eeprom)];
+  memcpy(saved, eeprom, sizeof(eeprom));
+  hal_reset();
+  memcpy(eeprom, saved, sizeof(eeprom));
+  MCUSR = mcusr;
+}
+
+// GPIO
+
+static void logGpio(uint8_t pin, uint8_t op, uint8_t value) {
+  charge(HAL_COST_GPIO_US);
+  hal_gpio_op o = {hal_cpu_time_us(), pin, op, value};
+  gpioLog.push_back(o);
+  if (gpioHook) {
+    gpioHook(o);
+  }
+}
+
+void pinMode(uint8_t pin, uint8_t mode) {
+  if (pin >= NUM_DIGITAL_PINS) {
+    return;
+  }
+  pinModes[pin] = mode;
+  logGpio(pin, HAL_OP_MODE, mode);
+}
+
+void digitalWrite(uint8_t pin, uint8_t val) {
+  if (pin >= NUM_DIGITAL_PINS) {
+    return;
+  }
+  pinValues[pin] = !!val;
+  logGpio(pin, HAL_OP_WRITE, !!val);
+}
+
+int digitalRead(uint8_t pin) {
+  return hal_pin_level(pin);
+}
+
+const std::vector<hal_gpio_op> &hal_gpio_log(void) {
+  return gpioLog;
+}
+
+void hal_gpio_clear(void) {
+  gpioLog.clear();
+}
+
+uint8_t hal_pin_mode(uint8_t pin) {
+  return pinModes[pin];
+}
+
+uint8_t hal_pin_value(uint8_t pin) {
+  return pinValues[pin];
+}
+
+uint8_t hal_pin_level(uint8_t pin) {
+  if (pinModes[pin] == OUTPUT) {
+    return pinValues[pin];
+  }
+  return pinInputs[pin];
+}
+
+void hal_gpio_hook(void (*hook)(const hal_gpio_op &op)) {
+  gpioHook = hook;
+}
+
+void attachInterrupt(uint8_t interrupt, void (*isr)(void), int mode) {
+  if (interrupt < 2) {
+    extIsr[interrupt] = isr;
+    extMode[interrupt] = mode;
+  }
+}
+
+void detachInterrupt(uint8_t interrupt) {
+  if (interrupt < 2) {
+    extIsr[interrupt] = NULL;
+  }
+}
+
+// Time
+
+unsigned long millis(void) {
+  return hal_cpu_time_us() / 1000;
+}
+
+unsigned long micros(void) {
+  return hal_cpu_time_us();
+}
+
+void delay(unsigned long ms) {
+  delayMicroseconds(ms * 1000);
+}
+
+void delayMicroseconds(unsigned int us) {
+  uint32_t debt = cpuDebt_us;
+  cpuDebt_us = 0;
+  hal_advance_us(debt + us);
+}
+
+char *itoa(int value, char *str, int base) {
+  static const char digits[] = "0123456789abcdefghijklmnopqrstuvwxyz";
+  char tmp[34];
+  int i = 0;
+  unsigned int v = (value < 0 && base == 10) ? -value : value;
+  do {
+    tmp[i++] = digits[v % base];
+    v /= base;
+  } while (v);
+  char *p = str;
+  if (value < 0 && base == 10) {
+    *p++ = '-';
+  }
+  while (i) {
+    *p++ = tmp[--i];
+  }
+  *p = 0;
+  return str;
+}
+
+// Serial
+
+void hal_serial_input(const std::string &s) {
+  serialIn.insert(serialIn.end(), s.begin(), s.end());
+}
+
+std::string hal_serial_output(void) {
+  std::string s;
+  s.swap(serialOut);
+  return s;
+}
+
+void HardwareSerial::begin(unsigned long baud) {
+  (void)baud;
+}
+
+int HardwareSerial::available(void) {
+  return serialIn.size();
+}
+
+int HardwareSerial::read(void) {
+  if (serialIn.empty()) {
+    return -1;
+  }
+  int c = serialIn.front();
+  serialIn.pop_front();
+  return c;
+}
+
+size_t HardwareSerial::write(uint8_t c) {
+  charge(HAL_COST_SERIAL_US);
+  serialOut += (char)c;
+  return 1;
+}
+
+size_t HardwareSerial::print(const char *s) {
+  size_t n = strlen(s);
+  charge(HAL_COST_SERIAL_US * n);
+  serialOut += s;
+  return n;
+}
+
+size_t HardwareSerial::print(const __FlashStringHelper *s) {
+  return print(reinterpret_cast<const char *>(s));
+}
+
+size_t HardwareSerial::print(char c) {
+  return write(c);
+}
+
+static size_t printNumber(unsigned long n, int base) {
+  char buf[8 * sizeof(long) + 1];
+  char *p = &buf[sizeof(buf) - 1];
+  *p = 0;
+  if (base < 2) {
+    base = 10;
+  }
+  do {
+    unsigned long d = n % base;
+    *--p = d < 10 ? '0' + d : 'A' + d - 10;
+    n /= base;
+  } while (n);
+  return Serial.print(p);
+}
+
+// AVR longs are 32 bits, keep the same output for negative numbers
+size_t HardwareSerial::print(long n, int base) {
+  if (base == DEC && n < 0) {
+    return print('-') + printNumber(-n, DEC);
+  }
+  return printNumber((uint32_t)n, base);
+}
+
+size_t HardwareSerial::print(unsigned long n, int base) {
+  return printNumber((uint32_t)n, base);
+}
+
+size_t HardwareSerial::print(unsigned char n, int base) {
+  return print((unsigned long)n, base);
+}
+
+size_t HardwareSerial::print(int n, int base) {
+  return print((long)n, base);
+}
+
+size_t HardwareSerial::print(unsigned int n, int base) {
+  return print((unsigned long)n, base);
+}
+
+size_t HardwareSerial::println(void) {
+  return print("\r\n");
+}
+
+// Watchdog
+
+void wdt_enable(uint8_t timeout) {
+  if (!wdtEnabled) {
+    wdtLast_us = now_us;
+  }
+  wdtEnabled = 1;
+  wdtTimeout_us = 15000UL << timeout;
+}
+
+void wdt_disable(void) {
+  wdtEnabled = 0;
+}
+
+void wdt_reset(void) {
+  wdtLast_us = now_us;
+}
+
+uint32_t hal_wdt_expired(void) {
+  return wdtExpired;
+}
+
+// Sleep
+
+void set_sleep_mode(uint8_t mode) {
+  (void)mode;
+}
+
+void sleep_enable(void) {
+  sleepEnabled = 1;
+}
+
+void sleep_disable(void) {
+  sleepEnabled = 0;
+}
+
+void sleep_cpu(void) {
+  if (sleepEnabled) {
+    sleeping = 1;
+  }
+}
+
+// EEPROM
+
+uint8_t *hal_eeprom(void) {
+  return eeprom;
+}
+
+uint8_t eeprom_read_byte(const uint8_t *addr) {
+  return eeprom[(uintptr_t)addr & E2END];
+}
+
+uint16_t eeprom_read_word(const uint16_t *addr) {
+  uintptr_t a = (uintptr_t)addr;
+  return eeprom[a & E2END] | eeprom[(a + 1) & E2END] << 8;
+}
+
+void eeprom_write_byte(uint8_t *addr, uint8_t value) {
+  eeprom[(uintptr_t)addr & E2END] = value;
+}
+
+void eeprom_write_word(uint16_t *addr, uint16_t value) {
+  uintptr_t a = (uintptr_t)addr;
+  eeprom[a & E2END] = value;
+  eeprom[(a + 1) & E2END] = value >> 8;
+}
+
+void eeprom_update_byte(uint8_t *addr, uint8_t value) {
+  eeprom_write_byte(addr, value);
+}
+
+int eeprom_is_ready(void) {
+  return 1;
+}
+
+// IR receiver
+
+IRrecv::IRrecv(int recvpin) {
+  irparams.recvpin = recvpin;
+}
+
+void IRrecv::enableIRIn(void) {
+  irparams.rcvstate = STATE_IDLE;
+  irparams.rawlen = 0;
+}
+
+bool IRrecv::isIdle(void) {
+  return irparams.rcvstate == STATE_IDLE || irparams.rcvstate == STATE_STOP;
+}
+
+void IRrecv::resume(void) {
+  irparams.rcvstate = STATE_IDLE;
+  irparams.rawlen = 0;
+}
+
+// Only the hash decoder of IRremote is modelled
+int IRrecv::decode(decode_results *results) {
+  if (irparams.rcvstate != STATE_STOP) {
+    return false;
+  }
+  if (hal_cpu_time_us() - irCaptured_us > irServiceMax_us) {
+    irServiceMax_us = hal_cpu_time_us() - irCaptured_us;
+  }
+  charge(HAL_COST_DECODE_US);
+  results->rawbuf = irparams.rawbuf;
+  results->rawlen = irparams.rawlen;
+  results->overflow = irparams.overflow;
+  results->decode_type = UNKNOWN;
+  if (results->rawlen < 6) {
+    resume();
+    return false;
+  }
+  uint32_t hash = 2166136261UL;
+  for (int i = 1; i + 2 < results->rawlen; i++) {
+    uint16_t a = results->rawbuf[i];
+    uint16_t b = results->rawbuf[i + 2];
+    int value = b < a * 8 / 10 ? 0 : (a < b * 8 / 10 ? 2 : 1);
+    hash = (hash * 16777619UL) ^ value;
+  }
+  results->value = hash;
+  results->bits = 32;
+  return true;
+}
+
+uint32_t hal_ir_frame_us(const std::vector<uint16_t> &ticks) {
+  uint32_t us = 0;
+  for (size_t i = 0; i < ticks.size(); i++) {
+    us += ticks[i] * MICROS_PER_TICK;
+  }
+  return us;
+}
+
+static void queueIR2(const std::vector<uint16_t> &ticks) {
+#ifdef IR2_RECEIVE_PIN
+  // Marks pull the TSOP output low
+  pin_edge e = {now_us, LOW};
+  std::deque<pin_edge> edges;
+  edges.push_back(e);
+  for (size_t i = 0; i < ticks.size(); i++) {
+    e.time_us += ticks[i] * MICROS_PER_TICK;
+    e.level = i & 1 ? LOW : HIGH;
+    edges.push_back(e);
+  }
+  // A trailing space is idle line, not a new mark
+  if (edges.back().level == LOW) {
+    edges.pop_back();
+  }
+  std::deque<pin_edge>::iterator it = ir2Edges.begin();
+  while (it != ir2Edges.end() && it->time_us <= now_us) {
+    ++it;
+  }
+  ir2Edges.insert(it, edges.begin(), edges.end());
+#else
+  (void)ticks;
+#endif
+}
+
+void hal_ir_raw(const std::vector<uint16_t> &ticks, uint8_t receivers) {
+  if (receivers & HAL_IR_RX2) {
+    queueIR2(ticks);
+  }
+  if (!(receivers & HAL_IR_RX1)) {
+    deliverIR2();
+    return;
+  }
+  ir_frame f;
+  f.start_us = now_us;
+  f.end_us = now_us + hal_ir_frame_us(ticks);
+  f.accepted = 0;
+  f.ticks = ticks;
+  // Without a gap the receiver merges the frames into one bad frame
+  if (!irFrames.empty() && irFrames.back().end_us + GAP_TICKS * MICROS_PER_TICK > now_us) {
+    irFrames.back().accepted = 2;
+    f.accepted = 2;
+  }
+  irFrames.push_back(f);
+  deliverIR();
+  deliverIR2();
+}
+
+// Keyboard frame: header, 14 symbols of 2 bits (low bits first), end mark
+std::vector<uint16_t> hal_ir_keyboard_ticks(uint32_t event) {
+  static const uint16_t space[] = {450, 650, 900, 1150};
+  uint32_t data = event & 0xffffff;
+  uint8_t chksum = 2;
+  for (uint32_t mask = 1; mask < 0x1000000; mask <<= 1) {
+    if (data & mask) chksum++;
+  }
+  data |= (uint32_t)(chksum & 0xf) << 24;
+  std::vector<uint16_t> ticks;
+  ticks.push_back(1000 / MICROS_PER_TICK);
+  ticks.push_back(500 / MICROS_PER_TICK);
+  for (int i = 0; i < 14; i++) {
+    ticks.push_back(500 / MICROS_PER_TICK);
+    ticks.push_back(space[(data >> (2 * i)) & 3] / MICROS_PER_TICK);
+  }
+  ticks.push_back(500 / MICROS_PER_TICK);
+  return ticks;
+}
+
+void hal_ir_keyboard(uint32_t event, uint8_t receivers) {
+  hal_ir_raw(hal_ir_keyboard_ticks(event), receivers);
+}
+
+// Joystick frame: 1200us header mark, 600us half bit space, then 16
+// Manchester coded bits MSB first, first half of the bit is the bit value
+std::vector<uint16_t> hal_ir_joystick_ticks(int8_t x, int8_t y, uint8_t button1, uint8_t button2) {
+  uint16_t value = ((x >> 2) & 0x3f) << 8 | ((y >> 2) & 0x3f);
+  if (button1) value |= 0x80;
+  if (button2) value |= 0x8000;
+  std::vector<uint8_t> half;
+  half.push_back(1);
+  half.push_back(1);
+  half.push_back(0);
+  for (int i = 15; i >= 0; i--) {
+    uint8_t b = (value >> i) & 1;
+    half.push_back(b);
+    half.push_back(!b);
+  }
+  while (!half.back()) {
+    half.pop_back();
+  }
+  std::vector<uint16_t> ticks;
+  uint8_t level = half[0];
+  uint16_t len = 0;
+  for (size_t i = 0; i < half.size(); i++) {
+    if (half[i] != level) {
+      ticks.push_back(len);
+      level = half[i];
+      len = 0;
+    }
+    len += 600 / MICROS_PER_TICK;
+  }
+  ticks.push_back(len);
+  return ticks;
+}
+
+// NEC frame of another remote: header, 32 bits low bit first, end mark.
+// The repeat frame is the header mark, a short space and the end mark.
+std::vector<uint16_t> hal_ir_nec_ticks(uint32_t code, uint8_t repeat) {
+  std::vector<uint16_t> ticks;
+  ticks.push_back(9000 / MICROS_PER_TICK);
+  if (repeat) {
+    ticks.push_back(2250 / MICROS_PER_TICK);
+  } else {
+    ticks.push_back(4500 / MICROS_PER_TICK);
+    for (int i = 0; i < 32; i++) {
+      ticks.push_back(560 / MICROS_PER_TICK);
+      ticks.push_back(((code >> i) & 1 ? 1690 : 560) / MICROS_PER_TICK);
+    }
+  }
+  ticks.push_back(560 / MICROS_PER_TICK);
+  return ticks;
+}
+
+void hal_ir_joystick(int8_t x, int8_t y, uint8_t button1, uint8_t button2, uint8_t receivers) {
+  hal_ir_raw(hal_ir_joystick_ticks(x, y, button1, button2), receivers);
+}
+
+// Device to host frame: start bit, 8 data bits LSB first, odd parity and
+// stop bit. Data changes while the clock is high and is read on the
+// falling edge.
+uint32_t hal_ps2(const std::vector<uint8_t> &bytes) {
+  uint32_t t = now_us;
+#ifdef PS2_CLOCK_PIN
+  if (!lineEdges.empty() && lineEdges.back().time_us + HAL_PS2_BYTE_GAP_US > t) {
+    t = lineEdges.back().time_us + HAL_PS2_BYTE_GAP_US;
+  }
+  uint32_t last = t;
+  for (size_t i = 0; i < bytes.size(); i++) {
+    uint16_t frame = (uint16_t)bytes[i] << 1 | 0x400;
+    if (!__builtin_parity(bytes[i])) {
+      frame |= 0x200;
+    }
+    for (int b = 0; b < 11; b++) {
+      line_edge data = {t, PS2_DATA_PIN, (uint8_t)((frame >> b) & 1)};
+      line_edge fall = {t + HAL_PS2_BIT_US / 2, PS2_CLOCK_PIN, LOW};
+      line_edge rise = {t + HAL_PS2_BIT_US, PS2_CLOCK_PIN, HIGH};
+      lineEdges.push_back(data);
+      lineEdges.push_back(fall);
+      lineEdges.push_back(rise);
+      last = fall.time_us;
+      t += HAL_PS2_BIT_US;
+    }
+    t += HAL_PS2_BYTE_GAP_US;
+  }
+  deliverLines();
+  return last;
+#else
+  (void)bytes;
+  return t;
+#endif
+}
+
+uint32_t hal_ir_dropped(void) {
+  return irDropped;
+}
+
+uint32_t hal_ir_service_max_us(void) {
+  return irServiceMax_us;
+}
+
+uint8_t hal_ir_pending(void) {
+  return !irFrames.empty() || !ir2Edges.empty() || irparams.rcvstate == STATE_STOP;
+}
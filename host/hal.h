@@ -0,0 +1,119 @@
+/*
+  hal.h - Host hardware abstraction for running the firmware natively
+
+  Copyright (c) 2022 Jarkko Sonninen
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef hal_h
+#define hal_h
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+// Firmware entry points from CIRKJOY.ino
+void setup(void);
+void loop(void);
+
+// Virtual clock. Time only moves when the harness advances it or the
+// firmware calls delay(). Timer interrupts and IR frames are delivered
+// while advancing.
+uint32_t hal_time_us(void);
+void hal_advance_us(uint32_t us);
+// Run loop() every HAL_LOOP_STEP_US until virtual time reaches 'us'. If
+// loop() went to sleep, the next one runs at the next interrupt, which is
+// the IRremote Timer2 tick every 50 us.
+#define HAL_LOOP_STEP_US 100
+void hal_run_until_us(uint32_t us);
+// Virtual time spent in sleep_cpu()
+uint32_t hal_sleep_us(void);
+
+// Optional CPU cost model. Each HAL call charges its approximate run time
+// on a 16 MHz Nano, and loop() then takes that long in virtual time.
+#define HAL_COST_GPIO_US 4      // pinMode(), digitalWrite()
+#define HAL_COST_DECODE_US 250  // IRremote decoders in IRrecv::decode()
+#define HAL_COST_SERIAL_US 10   // Serial byte into the TX buffer
+void hal_cpu_model(uint8_t enable);
+// Virtual time including the cost of the running loop()
+uint32_t hal_cpu_time_us(void);
+
+// Reset clock, pins, receiver, serial and EEPROM to power on state
+void hal_reset(void);
+// Reset without power loss, EEPROM and globals of the firmware are kept.
+// MCUSR is set to 'mcusr', such as _BV(WDRF) for a watchdog reset.
+void hal_restart(uint8_t mcusr);
+
+// GPIO writes and mode changes are logged with their virtual time
+#define HAL_OP_MODE 0
+#define HAL_OP_WRITE 1
+struct hal_gpio_op {
+  uint32_t time_us;
+  uint8_t pin;
+  uint8_t op;
+  uint8_t value;
+};
+const std::vector<hal_gpio_op> &hal_gpio_log(void);
+void hal_gpio_clear(void);
+uint8_t hal_pin_mode(uint8_t pin);
+uint8_t hal_pin_value(uint8_t pin);
+// Level seen on the wire, open collector outputs read as pulled up
+uint8_t hal_pin_level(uint8_t pin);
+void hal_gpio_hook(void (*hook)(const hal_gpio_op &op));
+
+// Serial pipes
+void hal_serial_input(const std::string &s);
+std::string hal_serial_output(void);
+
+// IR receivers. Frames start at the current virtual time. The IRremote
+// receiver captures them only if it is idle, as with its single buffer.
+// The second receiver, if IR2_RECEIVE_PIN is defined, sees the frame as
+// edges on its pin with pin change interrupts. 'receivers' selects which
+// of them get the frame, to simulate a shadowed receiver.
+#define HAL_IR_RX1 0x01
+#define HAL_IR_RX2 0x02
+#define HAL_IR_ALL (HAL_IR_RX1 | HAL_IR_RX2)
+void hal_ir_raw(const std::vector<uint16_t> &ticks, uint8_t receivers = HAL_IR_ALL);
+// Keyboard event as returned by read_IR(), checksum is filled in
+void hal_ir_keyboard(uint32_t event, uint8_t receivers = HAL_IR_ALL);
+// Stick position as returned by IREvent::joyX/joyY
+void hal_ir_joystick(int8_t x, int8_t y, uint8_t button1, uint8_t button2,
+  uint8_t receivers = HAL_IR_ALL);
+uint32_t hal_ir_frame_us(const std::vector<uint16_t> &ticks);
+std::vector<uint16_t> hal_ir_keyboard_ticks(uint32_t event);
+std::vector<uint16_t> hal_ir_joystick_ticks(int8_t x, int8_t y, uint8_t button1, uint8_t button2);
+// Frame of an NEC protocol remote, for learned buttons
+std::vector<uint16_t> hal_ir_nec_ticks(uint32_t code, uint8_t repeat);
+// Frames lost by the IRremote receiver
+uint32_t hal_ir_dropped(void);
+uint8_t hal_ir_pending(void);
+// Longest time from a captured frame to the decode() call servicing it
+uint32_t hal_ir_service_max_us(void);
+
+// PS/2 keyboard, if PS2_CLOCK_PIN is defined. Bytes are clocked in one
+// after another from the current virtual time, or after bytes still being
+// sent. Returns the time of the falling clock edge of the last stop bit.
+#define HAL_PS2_BIT_US 80       // 12.5 kHz clock
+#define HAL_PS2_BYTE_GAP_US 100 // Between bytes of one scan code
+uint32_t hal_ps2(const std::vector<uint8_t> &bytes);
+
+// EEPROM contents
+uint8_t *hal_eeprom(void);
+
+// Number of times the watchdog would have reset the MCU
+uint32_t hal_wdt_expired(void);
+
+#endif
@@ -0,0 +1,109 @@
+/*
+  IRremote.h - Host replacement of the IRremote 2.x receiver API
+
+  Copyright (c) 2022 Jarkko Sonninen
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef IRremote_h
+#define IRremote_h
+
+#include <Arduino.h>
+
+// Timing and matching as in IRremoteInt.h
+#define RAW_BUFFER_LENGTH 101
+#define MICROS_PER_TICK 50
+#define GAP_TICKS (5000 / MICROS_PER_TICK)
+#define MARK_EXCESS 100
+#define TOLERANCE 25
+#define LTOL (1.0 - (TOLERANCE / 100.))
+#define UTOL (1.0 + (TOLERANCE / 100.))
+#define TICKS_LOW(us) ((int)(((us) * LTOL / MICROS_PER_TICK)))
+#define TICKS_HIGH(us) ((int)(((us) * UTOL / MICROS_PER_TICK + 1)))
+
+#define STATE_IDLE 2
+#define STATE_MARK 3
+#define STATE_SPACE 4
+#define STATE_STOP 5
+#define STATE_OVERFLOW 6
+
+#define IR_DEBUG_PRINT(...)
+#define IR_DEBUG_PRINTLN(...)
+
+inline int MATCH(int measured, int desired) {
+  return measured >= TICKS_LOW(desired) && measured <= TICKS_HIGH(desired);
+}
+inline int MATCH_MARK(int measured_ticks, int desired_us) {
+  return MATCH(measured_ticks, desired_us + MARK_EXCESS);
+}
+inline int MATCH_SPACE(int measured_ticks, int desired_us) {
+  return MATCH(measured_ticks, desired_us - MARK_EXCESS);
+}
+
+typedef enum {
+  UNKNOWN = -1,
+  UNUSED = 0,
+  RC5,
+  RC6,
+  NEC,
+  SONY,
+  PANASONIC,
+  JVC,
+  SAMSUNG,
+  WHYNTER,
+  AIWA_RC_T501,
+  LG,
+  SANYO,
+  MITSUBISHI,
+  DISH,
+  SHARP,
+  SHARP_ALT,
+  DENON,
+  BOSEWAVE,
+} decode_type_t;
+
+typedef struct {
+  uint8_t recvpin;
+  uint8_t rcvstate;
+  unsigned int timer;
+  unsigned int rawbuf[RAW_BUFFER_LENGTH];
+  uint8_t rawlen;
+  uint8_t overflow;
+} irparams_t;
+
+extern volatile irparams_t irparams;
+
+class decode_results {
+  public:
+    decode_type_t decode_type;
+    unsigned int address;
+    unsigned long value;
+    int bits;
+    volatile unsigned int *rawbuf;
+    int rawlen;
+    int overflow;
+};
+
+class IRrecv {
+  public:
+    IRrecv(int recvpin);
+    void enableIRIn(void);
+    int decode(decode_results *results);
+    bool isIdle(void);
+    void resume(void);
+};
+
+#endif
@@ -0,0 +1,14 @@
+#ifndef host_eeprom_h
+#define host_eeprom_h
+
+#include <stdint.h>
+
+// 1 kB EEPROM of ATmega328P kept in host memory
+uint8_t eeprom_read_byte(const uint8_t *addr);
+uint16_t eeprom_read_word(const uint16_t *addr);
+void eeprom_write_byte(uint8_t *addr, uint8_t value);
+void eeprom_write_word(uint16_t *addr, uint16_t value);
+void eeprom_update_byte(uint8_t *addr, uint8_t value);
+int eeprom_is_ready(void);
+
+#endif
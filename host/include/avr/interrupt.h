@@ -0,0 +1,16 @@
+#ifndef host_interrupt_h
+#define host_interrupt_h
+
+// Interrupt handlers are called by the HAL from the virtual clock
+#define ISR(vector, ...) extern "C" void vector(void); void vector(void)
+
+#define TIMER1_COMPA_vect __vector_timer1_compa
+#define PCINT0_vect __vector_pcint0
+#define ANALOG_COMP_vect __vector_analog_comp
+
+#define cli()
+#define sei()
+#define noInterrupts()
+#define interrupts()
+
+#endif
@@ -0,0 +1,60 @@
+#ifndef host_io_h
+#define host_io_h
+
+#include <stdint.h>
+
+#ifndef F_CPU
+#define F_CPU 16000000UL
+#endif
+
+#define _BV(bit) (1 << (bit))
+
+#define E2END 0x3FF
+
+// Status register, only saved and restored around cli()
+extern volatile uint8_t SREG;
+
+// Timer1 registers, stepped by the HAL virtual clock
+extern volatile uint8_t TCCR1A;
+extern volatile uint8_t TCCR1B;
+extern volatile uint16_t TCNT1;
+extern volatile uint16_t OCR1A;
+extern volatile uint8_t TIMSK1;
+
+#define CS10 0
+#define CS11 1
+#define CS12 2
+#define WGM12 3
+#define OCIE1A 1
+
+// Pin change interrupt of port B, raised by the HAL on IR edges
+extern volatile uint8_t PCICR;
+extern volatile uint8_t PCMSK0;
+
+#define PCIE0 0
+
+// Analog comparator, raised by the HAL on edges of A7 when it compares
+// ADC7 against the bandgap. The ADC starts enabled as in the Arduino core.
+extern volatile uint8_t ACSR;
+extern volatile uint8_t ADCSRA;
+extern volatile uint8_t ADCSRB;
+extern volatile uint8_t ADMUX;
+
+#define ACIS0 0
+#define ACIS1 1
+#define ACIE 3
+#define ACI 4
+#define ACO 5
+#define ACBG 6
+#define ADEN 7
+#define ACME 6
+
+// Reset cause, set by hal_reset() and hal_restart()
+extern volatile uint8_t MCUSR;
+
+#define PORF 0
+#define EXTRF 1
+#define BORF 2
+#define WDRF 3
+
+#endif
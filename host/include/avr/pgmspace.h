@@ -0,0 +1,14 @@
+#ifndef host_pgmspace_h
+#define host_pgmspace_h
+
+#include <stdint.h>
+
+// Host has no separate program memory
+#define PROGMEM
+#define PSTR(s) (s)
+#define pgm_read_byte(addr) (*(const uint8_t *)(addr))
+#define pgm_read_word(addr) (*(const uint16_t *)(addr))
+#define pgm_read_dword(addr) (*(const uint32_t *)(addr))
+#define pgm_read_ptr(addr) (*(void * const *)(addr))
+
+#endif
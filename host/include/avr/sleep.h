@@ -0,0 +1,19 @@
+#ifndef host_sleep_h
+#define host_sleep_h
+
+#include <stdint.h>
+
+#define SLEEP_MODE_IDLE 0
+#define SLEEP_MODE_ADC 1
+#define SLEEP_MODE_PWR_DOWN 2
+#define SLEEP_MODE_PWR_SAVE 3
+#define SLEEP_MODE_STANDBY 6
+#define SLEEP_MODE_EXT_STANDBY 7
+
+// The HAL ends loop() and runs the clock to the next interrupt
+void set_sleep_mode(uint8_t mode);
+void sleep_enable(void);
+void sleep_disable(void);
+void sleep_cpu(void);
+
+#endif
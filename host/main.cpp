@@ -0,0 +1,87 @@
+/*
+  main.cpp - Run the firmware on the host from a script
+
+  Copyright (c) 2022 Jarkko Sonninen
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/* Runs the firmware with the script commands of script.h from a file or
+ * stdin and prints its Serial output.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <string>
+
+#include "hal.h"
+#include "script.h"
+
+static bool showGpio;
+
+static void printGpio(const hal_gpio_op &op) {
+  printf("%10u gpio %2u %s %u\n", op.time_us, op.pin,
+    op.op == HAL_OP_MODE ? "mode " : "write", op.value);
+}
+
+static void flushSerial(void) {
+  std::string s = hal_serial_output();
+  if (!s.empty()) {
+    fwrite(s.data(), 1, s.size(), stdout);
+  }
+}
+
+static void usage(const char *prog) {
+  fprintf(stderr, "Usage: %s [-g] [script]\n", prog);
+  fprintf(stderr, "  -g  print GPIO mode changes and writes\n");
+}
+
+int main(int argc, char **argv) {
+  int opt;
+  while ((opt = getopt(argc, argv, "gh")) != -1) {
+    switch (opt) {
+      case 'g':
+        showGpio = true;
+        break;
+      default:
+        usage(argv[0]);
+        return 1;
+    }
+  }
+  FILE *in = stdin;
+  if (optind < argc) {
+    in = fopen(argv[optind], "r");
+    if (!in) {
+      perror(argv[optind]);
+      return 1;
+    }
+  }
+
+  hal_reset();
+  if (showGpio) {
+    hal_gpio_hook(printGpio);
+  }
+  setup();
+
+  if (script_run(in, NULL, flushSerial)) {
+    return 1;
+  }
+  flushSerial();
+  if (hal_ir_dropped()) {
+    fprintf(stderr, "IR frames dropped: %u\n", hal_ir_dropped());
+  }
+  return 0;
+}
@@ -0,0 +1,123 @@
+/*
+  scnkey.cpp - Model of the C64 KERNAL keyboard scan for the host build
+
+  Copyright (c) 2022 Jarkko Sonninen
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "scnkey.h"
+#include "../c64key.h"
+
+Scnkey::Scnkey(const uint8_t *matrix)
+  : overflow(0), drain(SCNKEY_BUFFER), repeatAll(false), matrix(matrix),
+    lstx(SCNKEY_NO_KEY), delay(SCNKEY_DELAY), kount(SCNKEY_KOUNT) {
+}
+
+// Nodes 0..7 are PA lines, 8..15 PB lines. A closed switch joins them.
+uint8_t Scnkey::find(uint8_t n) {
+  while (component[n] != n) {
+    n = component[n];
+  }
+  return n;
+}
+
+void Scnkey::connect(void) {
+  for (uint8_t i = 0; i < 16; i++) {
+    component[i] = i;
+  }
+  for (uint8_t b = 0; b < 8; b++) {
+    for (uint8_t a = 0; a < 8; a++) {
+      if (matrix[b] & (1 << a)) {
+        uint8_t x = find(a);
+        uint8_t y = find(8 + b);
+        if (x != y) {
+          component[x] = y;
+        }
+      }
+    }
+  }
+}
+
+bool Scnkey::scan(uint8_t code) {
+  connect();
+  return find(code >> 3) == find(8 + (code & 7));
+}
+
+void Scnkey::put(uint8_t code, uint8_t shflag, uint8_t repeat) {
+  scnkey_key k = {code, shflag, repeat};
+  if (buffer.size() >= SCNKEY_BUFFER) {
+    overflow++;
+    return;
+  }
+  buffer.push_back(k);
+  typed.push_back(k);
+}
+
+// DEL, cursor keys and space repeat by default
+static bool isRepeatKey(uint8_t code) {
+  return code == CKM_DEL || code == CKM_CRSR_RIGHT || code == CKM_CRSR_DOWN || code == CKM_SPACE;
+}
+
+void Scnkey::jiffy(void) {
+  connect();
+  uint8_t sfdx = SCNKEY_NO_KEY;
+  uint8_t shflag = 0;
+  for (uint8_t code = 0; code < 64; code++) {
+    if (find(code >> 3) != find(8 + (code & 7))) {
+      continue;
+    }
+    switch (code) {
+      case CKM_L_SHIFT:
+      case CKM_R_SHIFT:
+        shflag |= 1;
+        break;
+      case CKM_CBM:
+        shflag |= 2;
+        break;
+      case CKM_CTRL:
+        shflag |= 4;
+        break;
+      default:
+        // The last key in scan order wins
+        sfdx = code;
+    }
+  }
+
+  if (sfdx != lstx) {
+    lstx = sfdx;
+    delay = SCNKEY_DELAY;
+    kount = SCNKEY_KOUNT;
+    if (sfdx != SCNKEY_NO_KEY) {
+      put(sfdx, shflag, 0);
+    }
+  } else if (sfdx != SCNKEY_NO_KEY && (repeatAll || isRepeatKey(sfdx))) {
+    bool wait = false;
+    if (delay) {
+      delay--;
+      wait = delay != 0;
+    }
+    if (!wait && --kount == 0) {
+      kount = SCNKEY_KOUNT;
+      // Repeat only when the program has taken the previous key
+      if (buffer.empty()) {
+        put(sfdx, shflag, 1);
+      }
+    }
+  }
+
+  size_t n = buffer.size() < drain ? buffer.size() : drain;
+  buffer.erase(buffer.begin(), buffer.begin() + n);
+}
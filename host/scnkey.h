@@ -0,0 +1,77 @@
+/*
+  scnkey.h - Model of the C64 KERNAL keyboard scan for the host build
+
+  Copyright (c) 2022 Jarkko Sonninen
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef scnkey_h
+#define scnkey_h
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+// KERNAL IRQ rate, CIA1 timer A on both PAL and NTSC machines
+#define SCNKEY_HZ 60
+#define SCNKEY_NO_KEY 64
+#define SCNKEY_BUFFER 10  // XMAX
+#define SCNKEY_DELAY 16   // Jiffies before the first repeat
+#define SCNKEY_KOUNT 4    // Jiffies between repeats
+
+// Key codes are matrix codes PA * 8 + PB, the same as CKM_ codes.
+// SHFLAG bits are kept with every buffered key.
+struct scnkey_key {
+  uint8_t code;
+  uint8_t shflag;
+  uint8_t repeat;
+};
+
+class Scnkey {
+  public:
+    // matrix points to C64keyboard::switchState, indexed by PB with PA bits
+    Scnkey(const uint8_t *matrix);
+
+    // One keyboard scan from the 60 Hz interrupt
+    void jiffy(void);
+
+    // Keys currently in the 10 byte keyboard buffer
+    std::vector<scnkey_key> buffer;
+    // Every key put into the buffer
+    std::vector<scnkey_key> typed;
+    // Keys lost because the buffer was full
+    uint32_t overflow;
+    // Keys the program takes from the buffer on each jiffy
+    uint8_t drain;
+    // Repeat all keys like POKE 650,128
+    bool repeatAll;
+
+    // Pressed state of a key as the CIA sees it, including ghost keys
+    // caused by current paths through three or more closed switches
+    bool scan(uint8_t code);
+
+  private:
+    const uint8_t *matrix;
+    uint8_t lstx;
+    uint8_t delay;
+    uint8_t kount;
+    uint8_t component[16];
+    void connect(void);
+    uint8_t find(uint8_t n);
+    void put(uint8_t code, uint8_t shflag, uint8_t repeat);
+};
+
+#endif
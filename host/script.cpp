@@ -0,0 +1,124 @@
+/*
+  script.cpp - Script commands for the host build
+
+  Copyright (c) 2022 Jarkko Sonninen
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include <stdlib.h>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "hal.h"
+#include "script.h"
+#include "../irkey.h"
+
+static int parseKeyCode(const std::string &name) {
+  char *end;
+  long code = strtol(name.c_str(), &end, 0);
+  if (*end == 0) {
+    return code;
+  }
+  for (int i = 0; i < 256; i++) {
+    if (name == key2sym(i)) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+int script_run(FILE *in, void (*wait)(uint32_t us), void (*line)(void)) {
+  if (!wait) {
+    wait = hal_run_until_us;
+  }
+  char buf[1024];
+  int lineNo = 0;
+  while (fgets(buf, sizeof(buf), in)) {
+    lineNo++;
+    std::istringstream args(buf);
+    std::string cmd;
+    if (!(args >> cmd) || cmd[0] == '#') {
+      continue;
+    }
+    if (cmd == "wait") {
+      uint32_t ms = 0;
+      args >> ms;
+      wait(hal_time_us() + ms * 1000);
+    } else if (cmd == "key") {
+      std::string name, flag;
+      args >> name;
+      int code = parseKeyCode(name);
+      if (code < 0) {
+        fprintf(stderr, "line %d: unknown key %s\n", lineNo, name.c_str());
+        return 1;
+      }
+      uint8_t header = IR_EV_KEYBOARD, modifier = 0;
+      while (args >> flag) {
+        if (flag == "shift") {
+          modifier |= IR_MOD_SHIFT;
+        } else if (flag == "release") {
+          header |= IR_EV_RELEASE;
+        } else if (flag == "repeat") {
+          header |= IR_EV_REPEAT;
+        }
+      }
+      hal_ir_keyboard(IREvent::key(header, modifier, code).raw());
+    } else if (cmd == "joy") {
+      int x = 0, y = 0;
+      std::string flag;
+      uint8_t b1 = 0, b2 = 0;
+      args >> x >> y;
+      while (args >> flag) {
+        if (flag == "b1") {
+          b1 = 1;
+        } else if (flag == "b2") {
+          b2 = 1;
+        }
+      }
+      hal_ir_joystick(x, y, b1, b2);
+    } else if (cmd == "raw") {
+      std::vector<uint16_t> ticks;
+      unsigned t;
+      while (args >> t) {
+        ticks.push_back(t);
+      }
+      hal_ir_raw(ticks);
+    } else if (cmd == "nec") {
+      std::string code, flag;
+      args >> code >> flag;
+      hal_ir_raw(hal_ir_nec_ticks(strtoul(code.c_str(), NULL, 0), flag == "repeat"));
+    } else if (cmd == "ps2") {
+      std::vector<uint8_t> bytes;
+      std::string b;
+      while (args >> b) {
+        bytes.push_back(strtol(b.c_str(), NULL, 16));
+      }
+      hal_ps2(bytes);
+    } else if (cmd == "serial") {
+      std::string text;
+      std::getline(args >> std::ws, text);
+      hal_serial_input(text);
+    } else {
+      fprintf(stderr, "line %d: unknown command %s\n", lineNo, cmd.c_str());
+      return 1;
+    }
+    if (line) {
+      line();
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,44 @@
+/*
+  script.h - Script commands for the host build
+
+  Copyright (c) 2022 Jarkko Sonninen
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef script_h
+#define script_h
+
+#include <stdint.h>
+#include <stdio.h>
+
+/* Script commands, one per line. Numbers may be decimal or 0x hex.
+ *  wait <ms>                  run loop() for ms of virtual time
+ *  key <code> [shift] [release] [repeat]
+ *                             send keyboard frame, code is IR key code or name in irkeys.txt
+ *  joy <x> <y> [b1] [b2]      send joystick frame, x and y -128..127
+ *  raw <ticks>...             send raw mark/space ticks of 50us
+ *  nec <code> [repeat]        send NEC frame of another remote, or its repeat frame
+ *  ps2 <hex>...               send PS/2 scan code bytes, if built with PS/2
+ *  serial <text>              write text to the serial input
+ *  # comment
+ */
+
+// Run the script from 'in' on the firmware after setup(). 'wait' runs
+// loop() until a virtual time, hal_run_until_us() if NULL, and 'line' is
+// called after every command. Returns 0, or 1 after printing an error.
+int script_run(FILE *in, void (*wait)(uint32_t us), void (*line)(void));
+
+#endif
@@ -0,0 +1,229 @@
+/*
+  trace2vcd.cpp - Convert firmware trace lines to a VCD file
+
+  Copyright (c) 2022 Jarkko Sonninen
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/* Reads the '@' trace lines described in trace.h from a Serial capture
+ * or a host build with CIRKJOY_TRACE and writes a Value Change Dump for
+ * GTKWave. Other lines are ignored. Time is in microseconds and
+ * wraparound of micros() is followed.
+ *
+ *   trace2vcd [trace.txt] > trace.vcd
+ */
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <Arduino.h>
+
+#include "../trace.h"
+
+char *c64key2str(uint8_t c);
+
+struct change {
+  uint64_t time;
+  int signal;
+  uint32_t value;
+};
+
+struct signal {
+  std::string scope;
+  std::string name;
+  int width;
+  std::string id;
+};
+
+static std::vector<signal> signals;
+static std::map<uint16_t, int> signalIndex;
+
+static bool changeBefore(const change &a, const change &b) {
+  return a.time < b.time;
+}
+
+static std::string vcdId(int n) {
+  std::string id;
+  do {
+    id += (char)('!' + n % 94);
+    n /= 94;
+  } while (n);
+  return id;
+}
+
+static std::string sanitize(const char *s) {
+  std::string out;
+  for (; *s; s++) {
+    out += isalnum((unsigned char)*s) ? *s : '_';
+  }
+  return out;
+}
+
+static int findSignal(const std::string &scope, const std::string &name, int width, uint16_t key) {
+  std::map<uint16_t, int>::iterator it = signalIndex.find(key);
+  if (it != signalIndex.end()) {
+    return it->second;
+  }
+  signal s = {scope, name, width, vcdId(signals.size())};
+  signals.push_back(s);
+  signalIndex[key] = signals.size() - 1;
+  return signals.size() - 1;
+}
+
+static const char *joyName(uint8_t pin) {
+  static const char *names[] = {"up", "down", "left", "right", "fire"};
+  static char buf[8];
+  if (pin >= A0 && pin <= A4) {
+    return names[pin - A0];
+  }
+  snprintf(buf, sizeof(buf), "pin%u", pin);
+  return buf;
+}
+
+static void printValue(FILE *out, const signal &s, uint32_t value) {
+  if (s.width == 1) {
+    fprintf(out, "%u%s\n", value & 1, s.id.c_str());
+    return;
+  }
+  fputc('b', out);
+  for (int i = s.width - 1; i >= 0; i--) {
+    fputc(value & (1UL << i) ? '1' : '0', out);
+  }
+  fprintf(out, " %s\n", s.id.c_str());
+}
+
+int main(int argc, char **argv) {
+  FILE *in = stdin;
+  if (argc > 2 || (argc == 2 && !strcmp(argv[1], "-h"))) {
+    fprintf(stderr, "Usage: %s [trace.txt] > trace.vcd\n", argv[0]);
+    return 1;
+  }
+  if (argc == 2) {
+    in = fopen(argv[1], "r");
+    if (!in) {
+      perror(argv[1]);
+      return 1;
+    }
+  }
+
+  std::vector<change> changes;
+  char line[256];
+  uint32_t last = 0;
+  uint64_t base = 0;
+  unsigned lost = 0;
+  while (fgets(line, sizeof(line), in)) {
+    unsigned long t, id, value;
+    char kind;
+    if (sscanf(line, "@%lu %c %lx %lx", &t, &kind, &id, &value) != 4) {
+      continue;
+    }
+    if (changes.size() && t < last) {
+      base += 1ULL << 32;
+    }
+    last = t;
+    uint64_t time = base + t;
+    int sig;
+    switch (kind) {
+      case TRACE_SWITCH:
+        sig = findSignal("matrix", "key_" + sanitize(c64key2str(id)), 1, 0x100 | id);
+        break;
+      case TRACE_JOY:
+        sig = findSignal("joystick", joyName(id), 1, 0x200 | id);
+        break;
+      case TRACE_NMI:
+        sig = findSignal("c64", "restore", 1, 0x300);
+        break;
+      case TRACE_IR: {
+        // A pulse marks every frame, also repeats of the same event
+        std::string n = "ir" + std::to_string(id + 1);
+        int frame = findSignal("ir", n + "_frame", 1, 0x400 | id);
+        change c = {time, frame, 1};
+        changes.push_back(c);
+        c.time = time + 1;
+        c.value = 0;
+        changes.push_back(c);
+        sig = findSignal("ir", n + "_event", 32, 0x500 | id);
+        break;
+      }
+      case TRACE_OVERFLOW:
+        lost += value;
+        continue;
+      default:
+        continue;
+    }
+    change c = {time, sig, (uint32_t)value};
+    changes.push_back(c);
+  }
+  if (in != stdin) {
+    fclose(in);
+  }
+  // IR frame pulses end after later changes at the same time
+  std::stable_sort(changes.begin(), changes.end(), changeBefore);
+  if (lost) {
+    fprintf(stderr, "%u trace entries were lost on the device\n", lost);
+  }
+
+  printf("$comment cirkjoy trace $end\n");
+  printf("$timescale 1us $end\n");
+  // Declarations grouped by scope, in order of first appearance
+  std::vector<std::string> scopes;
+  for (size_t i = 0; i < signals.size(); i++) {
+    if (std::find(scopes.begin(), scopes.end(), signals[i].scope) == scopes.end()) {
+      scopes.push_back(signals[i].scope);
+    }
+  }
+  for (size_t s = 0; s < scopes.size(); s++) {
+    printf("$scope module %s $end\n", scopes[s].c_str());
+    for (size_t i = 0; i < signals.size(); i++) {
+      if (signals[i].scope == scopes[s]) {
+        printf("$var wire %d %s %s $end\n", signals[i].width, signals[i].id.c_str(),
+          signals[i].name.c_str());
+      }
+    }
+    printf("$upscope $end\n");
+  }
+  printf("$enddefinitions $end\n");
+
+  // Everything starts released
+  std::vector<int64_t> current(signals.size(), -1);
+  printf("#0\n$dumpvars\n");
+  for (size_t i = 0; i < signals.size(); i++) {
+    printValue(stdout, signals[i], 0);
+    current[i] = 0;
+  }
+  printf("$end\n");
+
+  uint64_t now = 0;
+  for (size_t i = 0; i < changes.size(); i++) {
+    const change &c = changes[i];
+    if (current[c.signal] == c.value && signals[c.signal].width == 1) {
+      continue;
+    }
+    if (c.time != now) {
+      now = c.time;
+      printf("#%llu\n", (unsigned long long)now);
+    }
+    printValue(stdout, signals[c.signal], c.value);
+    current[c.signal] = c.value;
+  }
+  return 0;
+}
@@ -0,0 +1,373 @@
+/*
+  typing.cpp - Keystroke registration rate against the KERNAL scan model
+
+  Copyright (c) 2022 Jarkko Sonninen
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/* Types a sequence of keys over IR at a given rate into the firmware and
+ * runs the 60 Hz KERNAL keyboard scan model on the resulting switch matrix.
+ * Each keystroke is reported as seen, missed, doubled or ghosted. Every
+ * rate is run with several phases between the input and the scan.
+ *
+ * With -s the text is written to Serial instead and typed by the macro
+ * engine at its own pace, and the typed keys are compared to the text.
+ * With -p the keys are typed on the PS/2 keyboard, if built with it.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <algorithm>
+#include <vector>
+
+#include <IRremote.h>
+
+#include "hal.h"
+#include "scnkey.h"
+#include "../C64keyboard.hpp"
+#include "../irkey.h"
+#include "../mapping.h"
+#include "../macro.h"
+
+extern C64keyboard ckey;
+
+#define TYPING_KEYS 40
+#define TYPING_PHASES 6
+#define TYPING_FRAME_GAP_US (GAP_TICKS * MICROS_PER_TICK + 1000)
+
+struct result {
+  uint32_t keys;
+  uint32_t seen;
+  uint32_t missed;
+  uint32_t doubled;
+  uint32_t ghosted;
+  uint32_t overflow;
+  uint32_t duration_us;
+};
+
+// IR key, matrix key and PS/2 set 2 scan code
+static const uint8_t letters[][3] = {
+  {IR_KC_A, CKM_A, 0x1c}, {IR_KC_S, CKM_S, 0x1b}, {IR_KC_D, CKM_D, 0x23}, {IR_KC_F, CKM_F, 0x2b},
+  {IR_KC_J, CKM_J, 0x3b}, {IR_KC_K, CKM_K, 0x42}, {IR_KC_L, CKM_L, 0x4b}, {IR_KC_E, CKM_E, 0x24},
+  {IR_KC_R, CKM_R, 0x2d}, {IR_KC_U, CKM_U, 0x3c}, {IR_KC_I, CKM_I, 0x43}, {IR_KC_O, CKM_O, 0x44},
+};
+#define LETTERS (sizeof(letters) / sizeof(letters[0]))
+
+struct frame {
+  uint32_t at_us;
+  uint32_t event;
+};
+
+static bool frameBefore(const frame &a, const frame &b) {
+  return a.at_us < b.at_us;
+}
+
+static uint32_t holdMs;
+static uint8_t drain = SCNKEY_BUFFER;
+static bool ps2;
+
+static result run(double rate, uint32_t phase_us) {
+  std::vector<frame> frames;
+  std::vector<uint8_t> expected;
+  uint32_t period = 1000000 / rate;
+  uint32_t hold = holdMs ? holdMs * 1000 : period / 2;
+  uint32_t start = 100000;
+  for (int i = 0; i < TYPING_KEYS; i++) {
+    const uint8_t *k = letters[i % LETTERS];
+    frame press = {start + i * period, IREvent::key(IR_EV_KEYBOARD, 0, k[0]).raw() | (uint32_t)k[2] << 24};
+    frame release = {start + i * period + hold,
+                     IREvent::key(IR_EV_KEYBOARD | IR_EV_RELEASE, 0, k[0]).raw() | (uint32_t)k[2] << 24};
+    frames.push_back(press);
+    frames.push_back(release);
+    expected.push_back(k[1]);
+  }
+  std::stable_sort(frames.begin(), frames.end(), frameBefore);
+
+  hal_reset();
+  hal_cpu_model(1);
+  setup();
+  Scnkey scnkey(ckey.switchState);
+  scnkey.drain = drain;
+
+  uint32_t jiffy = phase_us;
+  uint32_t airFree = 0;
+  size_t next = 0;
+  uint32_t end = 0;
+  while (next < frames.size() || hal_time_us() < end) {
+    uint32_t t = end;
+    if (next < frames.size()) {
+      t = frames[next].at_us > airFree ? frames[next].at_us : airFree;
+    }
+    if (jiffy < t) {
+      t = jiffy;
+    }
+    hal_run_until_us(t);
+    if (hal_time_us() >= jiffy) {
+      scnkey.jiffy();
+      jiffy += 1000000 / SCNKEY_HZ;
+    }
+    if (next < frames.size() && hal_time_us() >= frames[next].at_us && hal_time_us() >= airFree) {
+      if (ps2) {
+#ifdef PS2_CLOCK_PIN
+        std::vector<uint8_t> bytes;
+        if (IREvent(frames[next].event).release()) {
+          bytes.push_back(0xf0);
+        }
+        bytes.push_back(frames[next].event >> 24);
+        hal_ps2(bytes);
+#endif
+      } else {
+        std::vector<uint16_t> ticks = hal_ir_keyboard_ticks(frames[next].event & 0xffffff);
+        airFree = hal_time_us() + hal_ir_frame_us(ticks) + TYPING_FRAME_GAP_US;
+        hal_ir_raw(ticks);
+      }
+      if (++next == frames.size()) {
+        end = hal_time_us() + 500000;
+      }
+    }
+  }
+
+  // Match typed keys to the expected sequence
+  result r = {};
+  r.keys = expected.size();
+  r.overflow = scnkey.overflow;
+  r.duration_us = hal_time_us() - start;
+  size_t e = 0;
+  for (size_t i = 0; i < scnkey.typed.size(); i++) {
+    uint8_t code = scnkey.typed[i].code;
+    if (e < expected.size() && code == expected[e]) {
+      r.seen++;
+      e++;
+      continue;
+    }
+    if (e > 0 && code == expected[e - 1]) {
+      r.doubled++;
+      continue;
+    }
+    size_t f = e;
+    while (f < expected.size() && f < e + 3 && expected[f] != code) {
+      f++;
+    }
+    if (f < expected.size() && expected[f] == code) {
+      r.missed += f - e;
+      r.seen++;
+      e = f + 1;
+    } else {
+      r.ghosted++;
+    }
+  }
+  r.missed += expected.size() - e;
+  return r;
+}
+
+// Each run starts the firmware from power on in a child process
+static result runChild(double rate, uint32_t phase_us) {
+  int fd[2];
+  result r = {};
+  if (pipe(fd) < 0) {
+    perror("pipe");
+    exit(1);
+  }
+  fflush(stdout);
+  pid_t pid = fork();
+  if (pid == 0) {
+    close(fd[0]);
+    r = run(rate, phase_us);
+    if (write(fd[1], &r, sizeof(r)) != sizeof(r)) {
+      _exit(1);
+    }
+    _exit(0);
+  }
+  close(fd[1]);
+  if (read(fd[0], &r, sizeof(r)) != sizeof(r)) {
+    fprintf(stderr, "run failed at %.1f keys/s\n", rate);
+  }
+  close(fd[0]);
+  waitpid(pid, NULL, 0);
+  return r;
+}
+
+static bool report(double rate) {
+  result sum = {};
+  for (int p = 0; p < TYPING_PHASES; p++) {
+    result r = runChild(rate, p * 1000000 / SCNKEY_HZ / TYPING_PHASES);
+    sum.keys += r.keys;
+    sum.seen += r.seen;
+    sum.missed += r.missed;
+    sum.doubled += r.doubled;
+    sum.ghosted += r.ghosted;
+    sum.overflow += r.overflow;
+    sum.duration_us += r.duration_us;
+  }
+  double actual = sum.keys * 1e6 / sum.duration_us;
+  printf("%7.1f %7.1f %6u %6u %6u %7u %7u %8u\n", rate, actual, sum.keys, sum.seen,
+    sum.missed, sum.doubled, sum.ghosted, sum.overflow);
+  return sum.seen == sum.keys && !sum.doubled && !sum.ghosted;
+}
+
+struct textResult {
+  uint32_t chars;
+  uint32_t typed;
+  uint32_t wrong;
+  uint32_t duration_us;
+};
+
+static textResult runText(const char *text, uint32_t phase_us) {
+  hal_reset();
+  hal_cpu_model(1);
+  setup();
+  Scnkey scnkey(ckey.switchState);
+  uint32_t start = 100000;
+  hal_run_until_us(start);
+  hal_serial_input(text);
+
+  std::vector<uint8_t> expected;
+  for (const char *c = text; *c; c++) {
+    if (macro_ascii(*c) != MACRO_NO_KEY) {
+      expected.push_back(macro_ascii(*c));
+    }
+  }
+  textResult r = {};
+  r.chars = expected.size();
+  uint32_t jiffy = start + phase_us;
+  uint32_t end = start + expected.size() * 2 * (MACRO_HOLD_MS + MACRO_GAP_MS) * 1000 + 500000;
+  while (hal_time_us() < end) {
+    hal_run_until_us(jiffy);
+    size_t before = scnkey.typed.size();
+    scnkey.jiffy();
+    if (scnkey.typed.size() != before) {
+      r.duration_us = hal_time_us() - start;
+    }
+    jiffy += 1000000 / SCNKEY_HZ;
+  }
+  r.typed = scnkey.typed.size();
+  for (size_t i = 0; i < expected.size(); i++) {
+    if (i >= scnkey.typed.size()) {
+      r.wrong++;
+      continue;
+    }
+    const scnkey_key &k = scnkey.typed[i];
+    uint8_t got = k.code | (k.shflag & 1 ? MACRO_SHIFT : 0);
+    if (got != expected[i] || k.repeat) {
+      r.wrong++;
+    }
+  }
+  return r;
+}
+
+static textResult runTextChild(const char *text, uint32_t phase_us) {
+  int fd[2];
+  textResult r = {};
+  if (pipe(fd) < 0) {
+    perror("pipe");
+    exit(1);
+  }
+  fflush(stdout);
+  pid_t pid = fork();
+  if (pid == 0) {
+    close(fd[0]);
+    r = runText(text, phase_us);
+    if (write(fd[1], &r, sizeof(r)) != sizeof(r)) {
+      _exit(1);
+    }
+    _exit(0);
+  }
+  close(fd[1]);
+  if (read(fd[0], &r, sizeof(r)) != sizeof(r)) {
+    fprintf(stderr, "text run failed\n");
+  }
+  close(fd[0]);
+  waitpid(pid, NULL, 0);
+  return r;
+}
+
+static int reportText(const char *text) {
+  printf("# serial text, %d scan phases, KERNAL scan %d Hz\n", TYPING_PHASES, SCNKEY_HZ);
+  printf("%8s %6s %6s %6s %7s\n", "phase_us", "chars", "typed", "wrong", "chars_s");
+  int failed = 0;
+  for (int p = 0; p < TYPING_PHASES; p++) {
+    uint32_t phase = p * 1000000 / SCNKEY_HZ / TYPING_PHASES;
+    textResult r = runTextChild(text, phase);
+    printf("%8u %6u %6u %6u %7.1f\n", phase, r.chars, r.typed, r.wrong,
+      r.duration_us ? r.chars * 1e6 / r.duration_us : 0.0);
+    failed |= r.wrong || r.typed != r.chars;
+  }
+  return failed;
+}
+
+static void usage(const char *prog) {
+  fprintf(stderr, "Usage: %s [-r keys_per_s] [-H hold_ms] [-d drain] [-s text] [-p]\n", prog);
+  fprintf(stderr, "  -r  run one rate instead of a sweep\n");
+  fprintf(stderr, "  -H  key hold time, default half of the key period\n");
+  fprintf(stderr, "  -d  keys the program takes from the buffer per jiffy\n");
+  fprintf(stderr, "  -s  type text from Serial with the macro engine\n");
+#ifdef PS2_CLOCK_PIN
+  fprintf(stderr, "  -p  type on the PS/2 keyboard instead of IR\n");
+#endif
+}
+
+int main(int argc, char **argv) {
+  double rate = 0;
+  const char *text = NULL;
+  int opt;
+  while ((opt = getopt(argc, argv, "r:H:d:s:ph")) != -1) {
+    switch (opt) {
+      case 'r':
+        rate = atof(optarg);
+        break;
+      case 'H':
+        holdMs = atoi(optarg);
+        break;
+      case 'd':
+        drain = atoi(optarg);
+        break;
+      case 's':
+        text = optarg;
+        break;
+#ifdef PS2_CLOCK_PIN
+      case 'p':
+        ps2 = true;
+        break;
+#endif
+      default:
+        usage(argv[0]);
+        return 1;
+    }
+  }
+  if (text) {
+    return reportText(text);
+  }
+  printf("# %d keys, %d scan phases, KERNAL scan %d Hz\n", TYPING_KEYS, TYPING_PHASES, SCNKEY_HZ);
+  printf("%7s %7s %6s %6s %6s %7s %7s %8s\n", "rate", "actual", "keys", "seen",
+    "missed", "doubled", "ghosted", "overflow");
+  if (rate > 0) {
+    return report(rate) ? 0 : 1;
+  }
+  // Highest rate below which every rate was reliable
+  double reliable = 0;
+  bool failed = false;
+  for (rate = 2; rate <= 30; rate += 1) {
+    if (report(rate) && !failed) {
+      reliable = rate;
+    } else {
+      failed = true;
+    }
+  }
+  printf("max_reliable_keys_s %.1f\n", reliable);
+  return 0;
+}
@@ -0,0 +1,419 @@
+/*
+  vice.cpp - Bridge from the host build to the VICE binary monitor
+
+  Copyright (c) 2022 Jarkko Sonninen
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/* Runs the firmware with the script commands of script.h and passes what
+ * reaches the C64 ports to a running VICE, started with
+ *
+ *   x64sc -binarymonitor -binarymonitoraddress ip4://127.0.0.1:6502
+ *
+ * The binary monitor has no command for the keyboard matrix, so the 60 Hz
+ * KERNAL scan model of scnkey.h runs on the switch matrix and every key it
+ * puts into the keyboard buffer is fed to VICE as PETSCII. Keys typed with
+ * C= or CTRL have no feed and are counted as lost. The joystick pins set
+ * port 2 with the joyport command. RESTORE has no command either, its
+ * pulses are only counted. Virtual time is paced to the wall clock unless
+ * -w is given, as VICE runs in real time.
+ *
+ * With -n nothing is sent and the commands are printed with their virtual
+ * time instead, which makes a regression test without VICE.
+ */
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+#include <string>
+#include <vector>
+
+#include "hal.h"
+#include "scnkey.h"
+#include "script.h"
+#include "../C64keyboard.hpp"
+
+extern C64keyboard ckey;
+
+#define VICE_PORT 6502
+#define VICE_STX 0x02
+#define VICE_API 0x02
+#define VICE_MEMORY_GET 0x01
+#define VICE_KEYBOARD_FEED 0x72
+#define VICE_JOYPORT_SET 0xa2
+#define VICE_JOYPORT2 1 // Joyport ids start from port 1 at 0
+#define VICE_EVENT 0xffffffff // Request id of responses nobody asked for
+
+#define VICE_SCREEN 0x0400
+#define VICE_STEP_US 1000 // Joystick and RESTORE sampling
+
+// KERNAL decode tables at $EB81 and $EBC2 by matrix code, 0 for SHIFT, C=
+// and CTRL which put nothing into the buffer
+static const uint8_t petsciiNormal[64] = {
+  0x14, 0x0d, 0x1d, 0x88, 0x85, 0x86, 0x87, 0x11,
+  0x33, 0x57, 0x41, 0x34, 0x5a, 0x53, 0x45, 0x00,
+  0x35, 0x52, 0x44, 0x36, 0x43, 0x46, 0x54, 0x58,
+  0x37, 0x59, 0x47, 0x38, 0x42, 0x48, 0x55, 0x56,
+  0x39, 0x49, 0x4a, 0x30, 0x4d, 0x4b, 0x4f, 0x4e,
+  0x2b, 0x50, 0x4c, 0x2d, 0x2e, 0x3a, 0x40, 0x2c,
+  0x5c, 0x2a, 0x3b, 0x13, 0x00, 0x3d, 0x5e, 0x2f,
+  0x31, 0x5f, 0x00, 0x32, 0x20, 0x00, 0x51, 0x03,
+};
+
+static const uint8_t petsciiShifted[64] = {
+  0x94, 0x8d, 0x9d, 0x8c, 0x89, 0x8a, 0x8b, 0x91,
+  0x23, 0xd7, 0xc1, 0x24, 0xda, 0xd3, 0xc5, 0x00,
+  0x25, 0xd2, 0xc4, 0x26, 0xc3, 0xc6, 0xd4, 0xd8,
+  0x27, 0xd9, 0xc7, 0x28, 0xc2, 0xc8, 0xd5, 0xd6,
+  0x29, 0xc9, 0xca, 0x30, 0xcd, 0xcb, 0xcf, 0xce,
+  0xdb, 0xd0, 0xcc, 0xdd, 0x3e, 0x5b, 0xba, 0x3c,
+  0xa9, 0xc0, 0x5d, 0x93, 0x00, 0x3d, 0xde, 0x3f,
+  0x21, 0x5f, 0x00, 0x22, 0xa0, 0x00, 0xd1, 0x83,
+};
+
+static const uint8_t joyPins[] = {A0, A1, A2, A3, A4};
+
+static bool dryRun;
+static bool warp;
+static int sock = -1;
+static uint32_t requestId;
+static Scnkey *scnkey;
+static size_t typedKeys;
+static uint32_t nextJiffy;
+static uint8_t joyValue;
+static uint8_t restoreLevel = 1;
+static uint32_t startTime_us;
+static struct timespec startWall;
+
+// Counters for the summary
+static uint32_t fed;
+static uint32_t lost;
+static uint32_t joyChanges;
+static uint32_t restores;
+
+static bool sendAll(const uint8_t *p, size_t len) {
+  while (len) {
+    ssize_t n = send(sock, p, len, 0);
+    if (n <= 0) {
+      perror("send");
+      return false;
+    }
+    p += n;
+    len -= n;
+  }
+  return true;
+}
+
+static bool recvAll(uint8_t *p, size_t len) {
+  while (len) {
+    ssize_t n = recv(sock, p, len, 0);
+    if (n <= 0) {
+      fprintf(stderr, "VICE closed the connection\n");
+      return false;
+    }
+    p += n;
+    len -= n;
+  }
+  return true;
+}
+
+static uint32_t le32(const uint8_t *p) {
+  return p[0] | p[1] << 8 | p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+// Send a command and wait for its response, skipping events such as
+// stopped and resumed. Returns false if VICE reported an error.
+static bool command(uint8_t type, const std::vector<uint8_t> &body,
+    std::vector<uint8_t> *response = NULL) {
+  uint32_t id = ++requestId;
+  std::vector<uint8_t> msg;
+  msg.push_back(VICE_STX);
+  msg.push_back(VICE_API);
+  for (uint8_t i = 0; i < 4; i++) {
+    msg.push_back(body.size() >> (8 * i));
+  }
+  for (uint8_t i = 0; i < 4; i++) {
+    msg.push_back(id >> (8 * i));
+  }
+  msg.push_back(type);
+  msg.insert(msg.end(), body.begin(), body.end());
+  if (!sendAll(msg.data(), msg.size())) {
+    exit(1);
+  }
+  for (;;) {
+    // STX, API version, body length, response type, error, request id
+    uint8_t header[12];
+    if (!recvAll(header, sizeof(header))) {
+      exit(1);
+    }
+    std::vector<uint8_t> data(le32(header + 2));
+    if (!data.empty() && !recvAll(data.data(), data.size())) {
+      exit(1);
+    }
+    if (le32(header + 8) != id) {
+      continue;
+    }
+    if (header[7]) {
+      fprintf(stderr, "VICE command 0x%02x: error 0x%02x\n", type, header[7]);
+      return false;
+    }
+    if (response) {
+      *response = data;
+    }
+    return true;
+  }
+}
+
+static bool connectVice(const char *host, int port) {
+  sock = socket(AF_INET, SOCK_STREAM, 0);
+  if (sock < 0) {
+    perror("socket");
+    return false;
+  }
+  struct sockaddr_in addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(port);
+  if (inet_pton(AF_INET, host, &addr.sin_addr) != 1) {
+    fprintf(stderr, "%s: not an IPv4 address\n", host);
+    return false;
+  }
+  if (connect(sock, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+    perror("connect");
+    return false;
+  }
+  return true;
+}
+
+// One key per command, the text is PETSCII
+static void feedKey(uint8_t petscii) {
+  if (dryRun) {
+    printf("%10u feed 0x%02x\n", hal_time_us(), petscii);
+  } else {
+    command(VICE_KEYBOARD_FEED, std::vector<uint8_t>{1, petscii});
+  }
+  fed++;
+}
+
+static void setJoyport(uint8_t value) {
+  if (dryRun) {
+    printf("%10u joy 2 0x%02x\n", hal_time_us(), value);
+  } else {
+    command(VICE_JOYPORT_SET, std::vector<uint8_t>{VICE_JOYPORT2, 0, value, 0});
+  }
+  joyChanges++;
+}
+
+// Pins are active low, the joyport value has up, down, left, right and
+// fire in bits 0..4 as setJoy1()
+static void samplePins(void) {
+  uint8_t value = 0;
+  for (uint8_t i = 0; i < sizeof(joyPins); i++) {
+    value |= !hal_pin_level(joyPins[i]) << i;
+  }
+  if (value != joyValue) {
+    joyValue = value;
+    setJoyport(value);
+  }
+  uint8_t level = hal_pin_level(ckey.nmiPin);
+  if (level != restoreLevel) {
+    restoreLevel = level;
+    if (!level) {
+      if (dryRun) {
+        printf("%10u restore\n", hal_time_us());
+      }
+      restores++;
+    }
+  }
+}
+
+static void feedTyped(void) {
+  for (; typedKeys < scnkey->typed.size(); typedKeys++) {
+    const scnkey_key &k = scnkey->typed[typedKeys];
+    uint8_t p = 0;
+    if (k.shflag == 0) {
+      p = petsciiNormal[k.code];
+    } else if (k.shflag == 1) {
+      p = petsciiShifted[k.code];
+    }
+    if (p) {
+      feedKey(p);
+    } else {
+      lost++;
+    }
+  }
+}
+
+// Sleep until the wall clock has caught up with virtual time
+static void pace(void) {
+  if (dryRun || warp) {
+    return;
+  }
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  int64_t wall_us = (int64_t)(now.tv_sec - startWall.tv_sec) * 1000000
+    + (now.tv_nsec - startWall.tv_nsec) / 1000;
+  int64_t ahead = (int64_t)(hal_time_us() - startTime_us) - wall_us;
+  if (ahead > 0) {
+    usleep(ahead);
+  }
+}
+
+static void runUntil(uint32_t us) {
+  while (hal_time_us() < us) {
+    uint32_t t = hal_time_us() + VICE_STEP_US;
+    if (t > nextJiffy) {
+      t = nextJiffy;
+    }
+    if (t > us) {
+      t = us;
+    }
+    hal_run_until_us(t);
+    samplePins();
+    if (hal_time_us() >= nextJiffy) {
+      scnkey->jiffy();
+      feedTyped();
+      nextJiffy += 1000000 / SCNKEY_HZ;
+    }
+    pace();
+  }
+}
+
+static void flushSerial(void) {
+  std::string s = hal_serial_output();
+  if (!s.empty()) {
+    fwrite(s.data(), 1, s.size(), stderr);
+  }
+}
+
+static char screenChar(uint8_t c) {
+  c &= 0x7f; // Reverse
+  if (c == 0) {
+    return '@';
+  }
+  if (c <= 0x1a) {
+    return 'A' + c - 1;
+  }
+  if (c == 0x1b || c == 0x1d) {
+    return c == 0x1b ? '[' : ']';
+  }
+  if (c >= 0x20 && c < 0x40) {
+    return c;
+  }
+  return '.';
+}
+
+// Text screen at $0400 as VICE has it now
+static void printScreen(void) {
+  std::vector<uint8_t> data;
+  std::vector<uint8_t> body = {0, VICE_SCREEN & 0xff, VICE_SCREEN >> 8,
+    (VICE_SCREEN + 999) & 0xff, (VICE_SCREEN + 999) >> 8, 0, 0, 0};
+  if (!command(VICE_MEMORY_GET, body, &data) || data.size() < 2 + 1000) {
+    return;
+  }
+  for (int row = 0; row < 25; row++) {
+    std::string line;
+    for (int col = 0; col < 40; col++) {
+      line += screenChar(data[2 + row * 40 + col]);
+    }
+    line.erase(line.find_last_not_of(' ') + 1);
+    printf("%s\n", line.c_str());
+  }
+}
+
+static void usage(const char *prog) {
+  fprintf(stderr, "Usage: %s [-n] [-w] [-s] [-a address] [-p port] [script]\n", prog);
+  fprintf(stderr, "  -n  print the commands instead of connecting to VICE\n");
+  fprintf(stderr, "  -w  do not pace to the wall clock, for VICE in warp mode\n");
+  fprintf(stderr, "  -s  print the C64 text screen at the end\n");
+  fprintf(stderr, "  -a  binary monitor address, default 127.0.0.1\n");
+  fprintf(stderr, "  -p  binary monitor port, default %d\n", VICE_PORT);
+}
+
+int main(int argc, char **argv) {
+  const char *host = "127.0.0.1";
+  int port = VICE_PORT;
+  bool screen = false;
+  int opt;
+  while ((opt = getopt(argc, argv, "nwsa:p:h")) != -1) {
+    switch (opt) {
+      case 'n':
+        dryRun = true;
+        break;
+      case 'w':
+        warp = true;
+        break;
+      case 's':
+        screen = true;
+        break;
+      case 'a':
+        host = optarg;
+        break;
+      case 'p':
+        port = atoi(optarg);
+        break;
+      default:
+        usage(argv[0]);
+        return 1;
+    }
+  }
+  FILE *in = stdin;
+  if (optind < argc) {
+    in = fopen(argv[optind], "r");
+    if (!in) {
+      perror(argv[optind]);
+      return 1;
+    }
+  }
+  if (!dryRun && !connectVice(host, port)) {
+    return 1;
+  }
+
+  hal_reset();
+  setup();
+  Scnkey model(ckey.switchState);
+  scnkey = &model;
+  nextJiffy = hal_time_us() + 1000000 / SCNKEY_HZ;
+  startTime_us = hal_time_us();
+  clock_gettime(CLOCK_MONOTONIC, &startWall);
+  samplePins();
+
+  if (script_run(in, runUntil, flushSerial)) {
+    return 1;
+  }
+  flushSerial();
+  if (screen && !dryRun) {
+    printScreen();
+  }
+
+  fflush(stdout);
+  double seconds = (hal_time_us() - startTime_us) / 1e6;
+  fprintf(stderr, "%.2f s: %u keys fed (%.1f/s), %u lost, %u joystick changes, "
+    "%u RESTORE not sent\n", seconds, fed, seconds > 0 ? fed / seconds : 0,
+    lost, joyChanges, restores);
+  if (hal_ir_dropped()) {
+    fprintf(stderr, "IR frames dropped: %u\n", hal_ir_dropped());
+  }
+  if (sock >= 0) {
+    close(sock);
+  }
+  return 0;
+}
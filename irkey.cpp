@@ -22,7 +22,10 @@
 #include <Arduino.h>
 
 #include <IRremote.h>
+#include <avr/interrupt.h>
 #include "irkey.h"
+#include "irmerge.h"
+#include "trace.h"
 
 //#define DEBUG 0
 
@@ -45,61 +48,166 @@ IRrecv irrecv(IR_RECEIVE_PIN);
 #define KEYB_10_SPACE  900
 #define KEYB_11_SPACE  1150
 
+#define JOY_BITS          16  // The number of bits in the command
+#define JOY_HDR_MARK     1200  // The length of the Header:Mark
+#define JOY_T1          600  // Manchester 600us - 1200us
+
+/* Symbol classes by length in ticks, read with one PROGMEM lookup per
+ * mark or space. The windows are the same as the microsecond compares
+ * they replace: keyboard spaces +-100 us checked in order 00..11, the
+ * keyboard bit mark as MATCH_MARK(), joystick half and full bits from
+ * -100 us up to but not including +100 us.
+ */
+#define SYM_TICKS        32     // Longer marks and spaces are errors
+#define SYM_KEYB_SPACE   0x03   // Keyboard space symbol 0..3
+#define SYM_KEYB_VALID   0x04   // Keyboard space symbol is valid
+#define SYM_KEYB_MARK    0x08   // Keyboard bit mark
+#define SYM_JOY_T1       0x10   // Joystick half bit
+#define SYM_JOY_T2       0x20   // Joystick full bit
+
+static constexpr bool inWindow(unsigned us, unsigned center) {
+  return us >= center - 100 && us <= center + 100;
+}
+
+static constexpr uint8_t keybSpace(unsigned us) {
+  return inWindow(us, KEYB_00_SPACE) ? SYM_KEYB_VALID | 0
+    : inWindow(us, KEYB_01_SPACE) ? SYM_KEYB_VALID | 1
+    : inWindow(us, KEYB_10_SPACE) ? SYM_KEYB_VALID | 2
+    : inWindow(us, KEYB_11_SPACE) ? SYM_KEYB_VALID | 3
+    : 0;
+}
+
+static constexpr uint8_t symClass(unsigned ticks) {
+  return keybSpace(ticks * MICROS_PER_TICK)
+    | ((int)ticks >= TICKS_LOW(KEYB_BIT_MARK + MARK_EXCESS)
+        && (int)ticks <= TICKS_HIGH(KEYB_BIT_MARK + MARK_EXCESS) ? SYM_KEYB_MARK : 0)
+    | (ticks * MICROS_PER_TICK >= JOY_T1 - 100 && ticks * MICROS_PER_TICK < JOY_T1 + 100 ? SYM_JOY_T1 : 0)
+    | (ticks * MICROS_PER_TICK >= JOY_T1 * 2 - 100 && ticks * MICROS_PER_TICK < JOY_T1 * 2 + 100 ? SYM_JOY_T2 : 0);
+}
+
+#define SYM4(t) symClass(t), symClass(t + 1), symClass(t + 2), symClass(t + 3)
+#define SYM16(t) SYM4(t), SYM4(t + 4), SYM4(t + 8), SYM4(t + 12)
+
+static const uint8_t symTable[SYM_TICKS] PROGMEM = { SYM16(0), SYM16(16) };
+
+static inline uint8_t symbol(unsigned int ticks) {
+  return ticks < SYM_TICKS ? pgm_read_byte(&symTable[ticks]) : 0;
+}
+
+#ifdef IR2_RECEIVE_PIN
+#if IR2_RECEIVE_PIN < 8 || IR2_RECEIVE_PIN > 13
+#error "IR2_RECEIVE_PIN must be on port B (D8..D13)"
+#endif
+
+/* The second receiver is captured from pin change interrupts into a
+ * buffer of the same format as irparams.rawbuf: gap, then mark and space
+ * lengths in 50 us ticks. The frame ends after GAP_TICKS of space, which
+ * is checked when polled.
+ */
+static volatile unsigned int rawbuf2[RAW_BUFFER_LENGTH];
+static volatile uint8_t rawlen2;
+static volatile uint8_t rcvstate2 = STATE_IDLE;
+static volatile uint32_t lastEdge2;
+
+ISR(PCINT0_vect) {
+  uint32_t now = micros();
+  uint8_t mark = !digitalRead(IR2_RECEIVE_PIN);  // TSOP output is active low
+  uint32_t ticks = (now - lastEdge2) / MICROS_PER_TICK;
+  if (rcvstate2 == STATE_SPACE && ticks > GAP_TICKS) {
+    // Previous frame ended before it was polled
+    rcvstate2 = STATE_STOP;
+  }
+  if (rcvstate2 == STATE_STOP) {
+    return;
+  }
+  if (rcvstate2 == STATE_IDLE) {
+    if (mark) {
+      rawbuf2[0] = ticks > 0x7fff ? 0x7fff : ticks;
+      rawlen2 = 1;
+      rcvstate2 = STATE_MARK;
+    }
+  } else if (rawlen2 < RAW_BUFFER_LENGTH) {
+    rawbuf2[rawlen2++] = ticks;
+    rcvstate2 = mark ? STATE_MARK : STATE_SPACE;
+  } else {
+    rcvstate2 = STATE_OVERFLOW;
+  }
+  lastEdge2 = now;
+}
+
+// Called by idle() with interrupts off, which must stay off
+static uint8_t IR2_available(void) {
+  uint8_t ready;
+  uint8_t sreg = SREG;
+  cli();
+  if ((rcvstate2 == STATE_SPACE || rcvstate2 == STATE_OVERFLOW)
+      && micros() - lastEdge2 > GAP_TICKS * MICROS_PER_TICK) {
+    rcvstate2 = STATE_STOP;
+  }
+  ready = rcvstate2 == STATE_STOP;
+  SREG = sreg;
+  return ready;
+}
+#endif
+
 void IR_setup(void) {
   irrecv.enableIRIn();  // Start the receiver
+  irmerge_reset();
+#ifdef IR2_RECEIVE_PIN
+  pinMode(IR2_RECEIVE_PIN, INPUT_PULLUP);
+  PCMSK0 |= _BV(IR2_RECEIVE_PIN - 8);
+  PCICR |= _BV(PCIE0);
+#endif
+}
+
+uint8_t IR_available(void) {
+#ifdef IR2_RECEIVE_PIN
+  if (IR2_available()) {
+    return 1;
+  }
+#endif
+  return irparams.rcvstate == STATE_STOP;
 }
 
-bool decodeKeyb(decode_results *results) {
+uint8_t decodeKeyb(decode_results *results) {
   uint32_t data = 0;
   unsigned int offset = 1;
   IR_DEBUG_PRINTLN("Attempting keyboard decode");
 
-  // Check SIZE
-  if (irparams.rawlen < KEYB_BITS / 2 + 3) {
-    return false;
+  // Check HDR Mark first, so that short frames are told apart by protocol
+  if (results->rawlen < 2 || !MATCH_MARK(results->rawbuf[offset], KEYB_HDR_MARK)) {
+    return IR_FAIL_HDR_MARK;
   }
+  offset++;
 
-  // Check HDR Mark/Space
-  if (!MATCH_MARK(results->rawbuf[offset], KEYB_HDR_MARK)) {
-    return false;
+  // Check SIZE
+  if (results->rawlen < KEYB_BITS + 3) {
+    return IR_FAIL_SIZE;
   }
-  offset++;
 
   if (!MATCH_SPACE(results->rawbuf[offset], KEYB_HDR_SPACE)) {
-    return false;
+    return IR_FAIL_HDR_SPACE;
   }
   offset++;
 
   for (int i = 0; i < KEYB_BITS; i += 2) {
-    int us = results->rawbuf[offset] * MICROS_PER_TICK;
-    if (!MATCH_MARK(results->rawbuf[offset], KEYB_BIT_MARK)) {
+    if (!(symbol(results->rawbuf[offset]) & SYM_KEYB_MARK)) {
       IR_DEBUG_PRINT("ERROR ");
       IR_DEBUG_PRINT(offset);
       IR_DEBUG_PRINT(",");
-      IR_DEBUG_PRINTLN(us);
-      return false;
+      IR_DEBUG_PRINTLN(results->rawbuf[offset] * MICROS_PER_TICK);
+      return IR_FAIL_BIT_MARK;
     }
     offset++;
-    us = results->rawbuf[offset] * MICROS_PER_TICK;
-    if (us >= KEYB_00_SPACE - 100 && us <= KEYB_00_SPACE + 100) {
-      data = (data >> 2);
-      //data = (data << 2);
-    } else if (us >= KEYB_01_SPACE - 100 && us <= KEYB_01_SPACE + 100) {
-      data = (data >> 2) | 0x40000000;
-      //  data = (data << 2) | 1;
-    } else if (us >= KEYB_10_SPACE - 100 && us <= KEYB_10_SPACE + 100) {
-      data = (data >> 2) | 0x80000000;
-      // data = (data << 2) | 2;
-    } else if (us >= KEYB_11_SPACE - 100 && us <= KEYB_11_SPACE + 100) {
-      data = (data >> 2) | 0xC0000000;
-      //data = (data << 2) | 3;
-    } else {
+    uint8_t sym = symbol(results->rawbuf[offset]);
+    if (!(sym & SYM_KEYB_VALID)) {
       IR_DEBUG_PRINT("ERROR ");
       IR_DEBUG_PRINT(offset);
       IR_DEBUG_PRINT(",");
-      IR_DEBUG_PRINTLN(us);
-      return false;
+      IR_DEBUG_PRINTLN(results->rawbuf[offset] * MICROS_PER_TICK);
+      return IR_FAIL_SPACE;
     }
+    data = (data >> 2) | (uint32_t)(sym & SYM_KEYB_SPACE) << 30;
     offset++;
   }
 
@@ -113,50 +221,46 @@ bool decodeKeyb(decode_results *results) {
   }
   if (chksum != data >> 24) {
     IR_DEBUG_PRINTLN("CHECKSUM ERROR");
-    return false;
+    return IR_FAIL_CHECKSUM;
   }
 
   results->value = data;
   results->decode_type = (decode_type_t)MY_DECODE_KEYBOARD;
-  return true;
+  return IR_OK;
 }
 
 
-#define JOY_BITS          16  // The number of bits in the command
-#define JOY_HDR_MARK     1200  // The length of the Header:Mark
-#define JOY_T1          600  // Manchester 600us - 1200us
-
-bool decodeJoy(decode_results *results) {
+uint8_t decodeJoy(decode_results *results) {
   unsigned long data = 0;  // Somewhere to build our code
   int offset = 1;  // Skip the Gap reading
   IR_DEBUG_PRINTLN("Attempting joystick decode");
 
-  if (irparams.rawlen < JOY_BITS + 1) {
-    return false;
-  }
-
   // Check initial Mark match
-  if (!MATCH_MARK(results->rawbuf[offset], JOY_HDR_MARK)) {
-    return false;
+  if (results->rawlen < 2 || !MATCH_MARK(results->rawbuf[offset], JOY_HDR_MARK)) {
+    return IR_FAIL_HDR_MARK;
   }
   offset++;
 
+  if (results->rawlen < JOY_BITS + 1) {
+    return IR_FAIL_SIZE;
+  }
+
   // Read the bits in
   bool skip = true;
   for (int i = 0; i < JOY_BITS; ) {
-    int us = results->rawbuf[offset] * MICROS_PER_TICK;
+    uint8_t sym = symbol(results->rawbuf[offset]);
     bool mark = (offset & 1);
     offset++;
-    if (offset > irparams.rawlen) {
+    if (offset > results->rawlen) {
       IR_DEBUG_PRINT("ERROR ");
       IR_DEBUG_PRINT(offset);
       IR_DEBUG_PRINT(",");
-      IR_DEBUG_PRINT(us);
+      IR_DEBUG_PRINT(results->rawbuf[offset - 1] * MICROS_PER_TICK);
       IR_DEBUG_PRINT(",");
-      IR_DEBUG_PRINTLN(irparams.rawlen);
-      return false;
+      IR_DEBUG_PRINTLN(results->rawlen);
+      return IR_FAIL_SIZE;
     }
-    if (us >= JOY_T1 - 100 && us < JOY_T1 + 100) {
+    if (sym & SYM_JOY_T1) {
       if (skip) {
         skip = false;
       } else {
@@ -168,7 +272,7 @@ bool decodeJoy(decode_results *results) {
         skip = true;
       }
 
-    } else if (us >= JOY_T1 * 2 - 100 && us < JOY_T1 * 2 + 100) {
+    } else if (sym & SYM_JOY_T2) {
       data = (data << 1);
       if (mark) {
         data = data | 1;
@@ -180,8 +284,8 @@ bool decodeJoy(decode_results *results) {
       IR_DEBUG_PRINT("ERROR ");
       IR_DEBUG_PRINT(offset);
       IR_DEBUG_PRINT(",");
-      IR_DEBUG_PRINTLN(us);
-      return false;
+      IR_DEBUG_PRINTLN(results->rawbuf[offset - 1] * MICROS_PER_TICK);
+      return mark ? IR_FAIL_BIT_MARK : IR_FAIL_SPACE;
     }
   }
 
@@ -189,69 +293,237 @@ bool decodeJoy(decode_results *results) {
   results->bits = JOY_BITS;
   results->value = data;
   results->decode_type = (decode_type_t)MY_DECODE_JOYSTICK;
-  return true;
+  return IR_OK;
 }
 
 
 //+=============================================================================
 
-static int calcKeybChecksum(uint32_t data) {
-  int chksum = 2;
-  for (uint32_t mask = 0x1, i = 0; i < 24; i++, mask <<= 1) {
-    if (data & mask) chksum++;
-  }
-  return chksum;
-}
-
 static void dumpInfo(decode_results *results);
 static void dumpCode(decode_results *results);
 static void dumpKeyb(uint32_t data);
 static void dumpJoy(uint32_t data);
 
+// Event of a decoded frame, 0 if none
+static uint32_t toEvent(decode_results *results) {
+  if (results->decode_type == MY_DECODE_KEYBOARD) {
+    int chksum = IR_keybChecksum(results->value);
+    if (chksum != IREvent(results->value).checksum()) {
+      return 0;
+    }
+    return results->value;
+  } else if (results->decode_type == MY_DECODE_JOYSTICK) {
+    // Convert joystick (remote) event to keyboard event
+    uint8_t header = (results->value & 0x80) ? IR_EV_BUTTON1 : 0;
+    header |= (results->value & 0x8000) ? IR_EV_BUTTON2 : 0;
+    uint32_t data = IREvent::joystick(header, results->value >> 8, results->value).raw();
+    if (data == 0) {
+      // When joy is returned to exact center, x and y may be zero
+      data = 1;
+    }
+    return data;
+  }
+
+  return 0;
+}
+
+static IR_stats stats;
+
+static inline void count(uint16_t *counter) {
+  if (*counter != 0xffff) {
+    (*counter)++;
+  }
+}
+
+#if IR_GLITCH_TICKS
+/* A mark or space of at most IR_GLITCH_TICKS is merged with the space or
+ * mark around it, so the decoders see the frame without it. A spike at
+ * either end of the frame is dropped with the space next to it. Returns
+ * the new length, under IR_MIN_RAWLEN if nothing but glitches was left.
+ */
+#define IR_MIN_RAWLEN 4 // Gap, mark, space, mark
+
+static uint8_t deglitch(volatile unsigned int *buf, uint8_t len) {
+  uint8_t w = 1;
+  for (uint8_t r = 1; r < len; r++) {
+    unsigned int t = buf[r];
+    if (t > IR_GLITCH_TICKS) {
+      buf[w++] = t;
+      continue;
+    }
+    count(&stats.glitches);
+    if (r + 1 >= len) {
+      if (w > 1) {
+        w--;
+      }
+      break;
+    }
+    r++;
+    if (w > 1) {
+      buf[w - 1] += t + buf[r];
+    }
+  }
+  if (w < IR_MIN_RAWLEN) {
+    count(&stats.noise);
+  }
+  return w;
+}
+#endif
+
+// A failed frame is counted for the first protocol whose header mark matched.
+// Returns the protocol.
+static uint8_t decodeFrame(decode_results *results) {
+  uint8_t proto = IR_PROTO_OTHER;
+  uint8_t keyb = decodeKeyb(results);
+  uint8_t joy = keyb == IR_OK ? IR_FAIL_HDR_MARK : decodeJoy(results);
+  if (keyb == IR_OK) {
+    proto = IR_PROTO_KEYB;
+    count(&stats.frames[IR_PROTO_KEYB][IR_OK]);
+    if (IREvent(results->value).repeat()) {
+      count(&stats.repeats);
+    }
+  } else if (joy == IR_OK) {
+    proto = IR_PROTO_JOY;
+    count(&stats.frames[IR_PROTO_JOY][IR_OK]);
+  } else if (keyb != IR_FAIL_HDR_MARK) {
+    proto = IR_PROTO_KEYB;
+    count(&stats.frames[IR_PROTO_KEYB][keyb]);
+  } else if (joy != IR_FAIL_HDR_MARK) {
+    proto = IR_PROTO_JOY;
+    count(&stats.frames[IR_PROTO_JOY][joy]);
+  } else {
+    count(&stats.frames[IR_PROTO_OTHER][IR_FAIL_HDR_MARK]);
+  }
+#ifdef DEBUG
+  Serial.println("");           // Blank line between entries
+  dumpInfo(results);            // Output the results
+  dumpCode(results);            // Output the results as source code
+#endif
+  return proto;
+}
+
+/* Frames of other remotes are known by a hash of their timing, as in
+ * IRremote decodeHash(): each mark or space is compared with the one two
+ * entries later as shorter, about equal or longer. Any protocol is told
+ * apart without a decoder for it, and both receivers give the same code.
+ */
+#define HASH_BASIS 2166136261UL  // FNV-1 32 bit
+#define HASH_PRIME 16777619UL
+#define HASH_MIN_RAWLEN 6        // Shorter frames are repeat frames
+
+static uint32_t otherCode;
+
+static void otherFrame(uint8_t receiver, decode_results *results) {
+  uint32_t code = IR_OTHER_REPEAT;
+  if (results->rawlen >= HASH_MIN_RAWLEN) {
+    code = HASH_BASIS;
+    for (int i = 1; i + 2 < results->rawlen; i++) {
+      unsigned int a = results->rawbuf[i];
+      unsigned int b = results->rawbuf[i + 2];
+      uint8_t value = b < a * 8 / 10 ? 0 : (a < b * 8 / 10 ? 2 : 1);
+      code = (code * HASH_PRIME) ^ value;
+    }
+  }
+  if (irmerge_frame(receiver, code, micros())) {
+    otherCode = code;
+  }
+}
+
+uint32_t IR_readOther(void) {
+  uint32_t code = otherCode;
+  otherCode = 0;
+  return code;
+}
+
 uint32_t read_IR () {
   decode_results results;        // Somewhere to store the results
+  uint32_t data;
   results.decode_type = UNKNOWN;
 
-  if (irrecv.decode(&results)) {  // Grab an IR code
-    decodeKeyb(&results);
-    decodeJoy(&results);
-#ifdef DEBUG
-    Serial.println("");           // Blank line between entries
-    dumpInfo(&results);           // Output the results
-    dumpCode(&results);           // Output the results as source code
+#if IR_GLITCH_TICKS
+  if (irparams.rcvstate == STATE_STOP) {
+    irparams.rawlen = deglitch(irparams.rawbuf, irparams.rawlen);
+    if (irparams.rawlen < IR_MIN_RAWLEN) {
+      // Spikes only, the IRremote decoders would reject it
+      irrecv.resume();
+    }
+  }
 #endif
-
+  if (irrecv.decode(&results)) {  // Grab an IR code
+    if (decodeFrame(&results) == IR_PROTO_OTHER) {
+      otherFrame(0, &results);
+    }
     irrecv.resume();              // Prepare for the next value
   }
+  data = toEvent(&results);
+  if (data && irmerge_frame(0, data, micros())) {
+    TRACE(TRACE_IR, 0, data);
+    return data;
+  }
 
-  if (results.decode_type == MY_DECODE_KEYBOARD) {
-    int chksum = calcKeybChecksum(results.value);
-    if (chksum != IR_GET_CHKSUM(results.value)) {
+#ifdef IR2_RECEIVE_PIN
+  if (IR2_available()) {
+#if IR_GLITCH_TICKS
+    rawlen2 = deglitch(rawbuf2, rawlen2);
+    if (rawlen2 < IR_MIN_RAWLEN) {
+      rcvstate2 = STATE_IDLE;
       return 0;
     }
-    return results.value;
-  } else if (results.decode_type == MY_DECODE_JOYSTICK) {
-    // Convert joystick (remote) event to keyboard event
-    uint32_t data = 0;
-    ((struct keyb_event*)&data)->header |= (results.value & 0x80) ? 0x20 : 0;
-    ((struct keyb_event*)&data)->header |= (results.value & 0x8000) ? 0x40 : 0;
-    (((struct keyb_event*)&data)->u.joy_ev.x = results.value >> 8) & 0x3f;
-    (((struct keyb_event*)&data)->u.joy_ev.y = results.value >> 0) & 0x3f;
-    if (data == 0) {
-      // When joy is returned to exact center, x and y may be zero
-      data = 1;
+#endif
+    results.decode_type = UNKNOWN;
+    results.rawbuf = rawbuf2;
+    results.rawlen = rawlen2;
+    results.overflow = rawlen2 >= RAW_BUFFER_LENGTH;
+    if (decodeFrame(&results) == IR_PROTO_OTHER) {
+      otherFrame(1, &results);
+    }
+    rcvstate2 = STATE_IDLE;
+    data = toEvent(&results);
+    if (data && irmerge_frame(1, data, micros())) {
+      TRACE(TRACE_IR, 1, data);
+      return data;
     }
-    return data;
   }
+#endif
 
   return 0;
 }
 
+const IR_stats *IR_getStats(void) {
+  return &stats;
+}
+
+void IR_clearStats(void) {
+  memset(&stats, 0, sizeof(stats));
+}
+
+// One line: protocol letter and counters in IR_OK, IR_FAIL_* order for
+// each protocol, then keyboard repeats, glitches and noise frames
+void IR_printStats(void) {
+  static const char proto[IR_PROTOCOLS] = {'K', 'J', 'O'};
+  Serial.print("IRSTAT");
+  for (uint8_t p = 0; p < IR_PROTOCOLS; p++) {
+    Serial.print(' ');
+    Serial.print(proto[p]);
+    for (uint8_t r = 0; r < IR_RESULTS; r++) {
+      Serial.print(r ? ',' : ' ');
+      Serial.print(stats.frames[p][r]);
+    }
+  }
+  Serial.print(" R ");
+  Serial.print(stats.repeats);
+  Serial.print(" G ");
+  Serial.print(stats.glitches);
+  Serial.print(',');
+  Serial.println(stats.noise);
+}
+
 const char *key2sym(uint8_t key) {
   switch (key) {
       // sed -e 's,^,case 0x,' -e 's/=/: return "/' -e 's/$/";/' < irkeys.txt > irkeys_names.h
 #include "irkeys_names.h"
   }
+  return "";
 }
 
 #ifdef DEBUG
@@ -431,51 +703,50 @@ static void dumpCode(decode_results *results) {
 }
 
 static void dumpKeyb(uint32_t data) {
-  int chksum = calcKeybChecksum(data);
-  struct keyb_event p;
-  *((uint32_t*)(&p)) = data;
+  IREvent p(data);
+  int chksum = IR_keybChecksum(data);
   Serial.print("chk:");
-  Serial.print(p.chksum, HEX);
-  Serial.print(chksum == p.chksum ? " OK" : " ERROR");
+  Serial.print(p.checksum(), HEX);
+  Serial.print(chksum == p.checksum() ? " OK" : " ERROR");
   Serial.print(",header:");
-  Serial.print(p.header, HEX);
-  if (p.header & 0x02) {
+  Serial.print(p.header(), HEX);
+  if (p.isKeyboard()) {
     Serial.print("+KEY");
-    if (p.header & 0x80) {
+    if (p.release()) {
       Serial.print("+RELEASE");
     }
-    if (p.header & 0x40) {
+    if (p.repeat()) {
       Serial.print("+REPEAT");
     }
     Serial.print(",mods:");
-    Serial.print(p.u.key_ev.modifier, HEX);
-    if (p.u.key_ev.modifier & 0x01) {
+    Serial.print(p.modifier(), HEX);
+    if (p.shift()) {
       Serial.print("+SHIFT");
     }
-    if (p.u.key_ev.modifier & 0x02) {
+    if (p.alt()) {
       Serial.print("+ALT");
     }
-    if (p.u.key_ev.modifier & 0x04) {
+    if (p.ctrl()) {
       Serial.print("+CTRL");
     }
-    if (p.u.key_ev.modifier & 0x08) {
+    if (p.gui()) {
       Serial.print("+WIN");
     }
     Serial.print(",code:");
-    Serial.print(p.u.key_ev.code, HEX);
+    Serial.print(p.code(), HEX);
     Serial.print(" ");
-    Serial.print(key2sym(p.u.key_ev.code));
+    Serial.print(key2sym(p.code()));
   } else {
-    if (p.header & 0x20) {
+    if (p.button1()) {
       Serial.print("+BUTTON1");
     }
-    if (p.header & 0x40) {
+    if (p.button2()) {
       Serial.print("+BUTTON2");
     }
     Serial.print(" x:");
-    Serial.print((short)(char)(p.u.joy_ev.x<<2), DEC);
+    Serial.print(p.joyX(), DEC);
     Serial.print(",y:");
-    Serial.print((short)(char)(p.u.joy_ev.y<<2), DEC);
+    Serial.print(p.joyY(), DEC);
   }
 }
 
@@ -21,46 +21,116 @@
 #ifndef irkey_h
 #define irkey_h
 
+// Optional second receiver for diversity. It must be on port B (D8..D13)
+// for the pin change interrupt. D13 is the only free pin, and on a Nano it
+// has the L LED with a 1 kOhm resistor to GND, which holds the receiver
+// output at about 1.7 V, a mark to the input. Remove the LED or its
+// resistor, or add a pull-up of 1 kOhm or less to 5 V. The activity LED
+// is not used when the second receiver is connected.
+//#define IR2_RECEIVE_PIN 13
+
+// Marks and spaces of at most this many 50 us ticks are spikes or dropouts
+// from ambient light and are merged away before decoding, 0 disables.
+// The shortest mark or space of the remotes is 450 us.
+#define IR_GLITCH_TICKS 2
+
+// Decode results, counted per protocol
+#define IR_OK 0
+#define IR_FAIL_SIZE 1
+#define IR_FAIL_HDR_MARK 2
+#define IR_FAIL_HDR_SPACE 3
+#define IR_FAIL_BIT_MARK 4
+#define IR_FAIL_SPACE 5
+#define IR_FAIL_CHECKSUM 6
+#define IR_RESULTS 7
+
+#define IR_PROTO_KEYB 0
+#define IR_PROTO_JOY 1
+#define IR_PROTO_OTHER 2 // No header mark matched
+#define IR_PROTOCOLS 3
+
+// Counters saturate at 0xffff
+typedef struct {
+  uint16_t frames[IR_PROTOCOLS][IR_RESULTS];
+  uint16_t repeats; // Accepted keyboard repeat frames
+  uint16_t glitches; // Marks and spaces merged away as glitches
+  uint16_t noise;    // Frames of nothing but glitches, not decoded
+} IR_stats;
+
 void IR_setup(void);
 uint32_t read_IR ();
+// A captured frame is waiting for read_IR()
+uint8_t IR_available(void);
+// Code of the last frame read_IR() got from another remote, 0 if none.
+// Frames too short to have a code, like NEC repeats, are IR_OTHER_REPEAT.
+#define IR_OTHER_REPEAT 0xffffffff
+uint32_t IR_readOther(void);
 const char *key2sym(uint8_t key);
+const IR_stats *IR_getStats(void);
+void IR_clearStats(void);
+// Snapshot of the counters as one line on Serial
+void IR_printStats(void);
+// Checksum of a keyboard event, 2 plus the number of set bits in bits 0..23
+constexpr uint8_t IR_keybChecksum(uint32_t data) {
+  return 2 + __builtin_popcountl(data & 0xffffff);
+}
 
-struct keyb_event {
-  uint8_t header;
-  union {
-    struct {
-      uint8_t modifier;
-      uint8_t code;
-    } key_ev;
-    struct {
-      uint8_t x: 6;
-      uint8_t y: 6;
-      uint8_t pad: 4;
-    } joy_ev;
-  } u;
-  uint8_t chksum: 4;
-  uint8_t pad: 4;
-};
+/* Input event from read_IR(), read_PS2() and the recorder, in 32 bits:
+ *  bits 0..7    header, IR_EV_ flags
+ *  keyboard     bits 8..15 modifier, 16..23 key code, 24..27 checksum
+ *  joystick     bits 8..13 x, 14..19 y, 6 bit two's complement
+ * This is the bit order of the IR keyboard frame. 0 is no event. Fields
+ * are read with shifts and masks, so an event stays in registers and has
+ * the same layout on the host.
+ */
+#define IR_EV_KEYBOARD 0x02
+#define IR_EV_BUTTON1 0x20
+#define IR_EV_BUTTON2 0x40
+#define IR_EV_REPEAT 0x40
+#define IR_EV_RELEASE 0x80
 
-#define IR_GET_CHKSUM(data) (((struct keyb_event*)&data)->chksum)
-#define IR_GET_HEADER(data) (((struct keyb_event*)&data)->header)
+#define IR_MOD_SHIFT 0x01
+#define IR_MOD_ALT 0x02
+#define IR_MOD_CTRL 0x04
+#define IR_MOD_GUI 0x08
 
-#define IR_GET_KEYBOARD(data) (((struct keyb_event*)&data)->header & 0x02)
-#define IR_GET_RELEASE(data) (((struct keyb_event*)&data)->header & 0x80)
-#define IR_GET_REPEAT(data) (((struct keyb_event*)&data)->header & 0x40)
+class IREvent {
+  public:
+    constexpr IREvent(uint32_t value = 0) : value(value) {}
+    static constexpr IREvent key(uint8_t header, uint8_t modifier, uint8_t code) {
+      return IREvent(header | (uint32_t)modifier << 8 | (uint32_t)code << 16);
+    }
+    // x and y are the 6 bit stick position
+    static constexpr IREvent joystick(uint8_t header, uint8_t x, uint8_t y) {
+      return IREvent(header | (uint32_t)(x & 0x3f) << 8 | (uint32_t)(y & 0x3f) << 14);
+    }
 
-#define IR_GET_CODE(data) (((struct keyb_event*)&data)->u.key_ev.code)
-#define IR_GET_MODIFIER(data) (((struct keyb_event*)&data)->u.key_ev.modifier)
+    constexpr uint32_t raw() const { return value; }
+    constexpr uint8_t header() const { return value & 0xff; }
+    constexpr bool isKeyboard() const { return value & IR_EV_KEYBOARD; }
+    constexpr bool release() const { return value & IR_EV_RELEASE; }
+    constexpr bool repeat() const { return value & IR_EV_REPEAT; }
 
-#define IR_GET_SHIFT(data) (((struct keyb_event*)&data)->u.key_ev.modifier & 0x01)
-#define IR_GET_ALT(data) (((struct keyb_event*)&data)->u.key_ev.modifier & 0x02)
-#define IR_GET_CTRL(data) (((struct keyb_event*)&data)->u.key_ev.modifier & 0x04)
-#define IR_GET_GUI(data) (((struct keyb_event*)&data)->u.key_ev.modifier & 0x08)
+    constexpr uint8_t modifier() const { return (value >> 8) & 0xff; }
+    constexpr uint8_t code() const { return (value >> 16) & 0xff; }
+    constexpr uint8_t checksum() const { return (value >> 24) & 0x0f; }
+    constexpr bool shift() const { return value & (uint32_t)IR_MOD_SHIFT << 8; }
+    constexpr bool alt() const { return value & (uint32_t)IR_MOD_ALT << 8; }
+    constexpr bool ctrl() const { return value & (uint32_t)IR_MOD_CTRL << 8; }
+    constexpr bool gui() const { return value & (uint32_t)IR_MOD_GUI << 8; }
+    // Keyboard event with the checksum filled in
+    constexpr IREvent withChecksum() const {
+      return IREvent((value & 0xffffff) | (uint32_t)(IR_keybChecksum(value) & 0x0f) << 24);
+    }
 
-#define IR_GET_JOY_X(data) ((int8_t)(((struct keyb_event*)&data)->u.joy_ev.x<<2))
-#define IR_GET_JOY_Y(data) ((int8_t)(((struct keyb_event*)&data)->u.joy_ev.y<<2))
+    // Stick position -128..124 in steps of 4
+    constexpr int8_t joyX() const { return (int8_t)((value >> 6) & 0xfc); }
+    constexpr int8_t joyY() const { return (int8_t)((value >> 12) & 0xfc); }
+    constexpr bool button1() const { return value & IR_EV_BUTTON1; }
+    constexpr bool button2() const { return value & IR_EV_BUTTON2; }
 
-#define IR_GET_BUTTON1(data) (((struct keyb_event*)&data)->header & 0x20)
-#define IR_GET_BUTTON2(data) (((struct keyb_event*)&data)->header & 0x40)
+  private:
+    uint32_t value;
+};
 
 #endif
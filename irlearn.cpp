@@ -0,0 +1,210 @@
+/*
+  irlearn.cpp - Buttons of other IR remotes learned as C64 keys
+
+  Copyright (c) 2022 Jarkko Sonninen
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include <Arduino.h>
+#include <avr/eeprom.h>
+
+#include "C64keyboard.hpp"
+#include "irkey.h"
+#include "irlearn.h"
+
+#define IRLEARN_MAGIC 0xc7
+#define IRLEARN_ENTRY 6
+#define IRLEARN_DELETED 0xfffe // Keeps probe chains through a forgotten code
+
+#define STATE_IDLE 0
+#define STATE_CODE 1   // Waiting for a button of the other remote
+#define STATE_TARGET 2 // Waiting for the key to bind it to
+
+struct learnSlot {
+  uint32_t code;
+  uint16_t target; // IRLEARN_NONE if free
+};
+
+static learnSlot table[IRLEARN_SLOTS];
+static uint8_t used;
+static uint8_t state;
+static uint32_t pending;
+static uint16_t held = IRLEARN_NONE; // Target down now
+static uint16_t next = IRLEARN_NONE; // Target to press on the next poll
+static uint32_t expires;
+
+static uint16_t entryAddress(uint8_t slot) {
+  return IRLEARN_EEPROM_START + 1 + slot * IRLEARN_ENTRY;
+}
+
+// Bytes that did not change are not written, as each byte takes 3.3 ms
+static void saveTarget(uint8_t slot) {
+  uint8_t *p = (uint8_t *)entryAddress(slot) + 4;
+  eeprom_update_byte(p, table[slot].target);
+  eeprom_update_byte(p + 1, table[slot].target >> 8);
+}
+
+static void saveSlot(uint8_t slot) {
+  uint8_t *p = (uint8_t *)entryAddress(slot);
+  for (uint8_t i = 0; i < 4; i++) {
+    eeprom_update_byte(p++, table[slot].code >> (8 * i));
+  }
+  saveTarget(slot);
+}
+
+void irlearn_begin(void) {
+  used = 0;
+  uint8_t valid = eeprom_read_byte((const uint8_t *)IRLEARN_EEPROM_START) == IRLEARN_MAGIC;
+  for (uint8_t s = 0; s < IRLEARN_SLOTS; s++) {
+    const uint8_t *p = (const uint8_t *)entryAddress(s);
+    table[s].code = 0;
+    for (uint8_t i = 0; i < 4; i++) {
+      table[s].code |= (uint32_t)eeprom_read_byte(p++) << (8 * i);
+    }
+    table[s].target = eeprom_read_byte(p) | eeprom_read_byte(p + 1) << 8;
+    if (!valid) {
+      table[s].target = IRLEARN_NONE;
+    }
+    if (table[s].target < IRLEARN_DELETED) {
+      used++;
+    }
+  }
+}
+
+// Slot of the code, or else the first free slot on its probe chain.
+// Returns IRLEARN_SLOTS if neither was found.
+static uint8_t findSlot(uint32_t code) {
+  uint8_t freeSlot = IRLEARN_SLOTS;
+  uint8_t s = code & (IRLEARN_SLOTS - 1);
+  for (uint8_t n = 0; n < IRLEARN_SLOTS; n++) {
+    uint16_t t = table[s].target;
+    if (t == IRLEARN_NONE) {
+      return freeSlot < IRLEARN_SLOTS ? freeSlot : s;
+    }
+    if (t == IRLEARN_DELETED) {
+      if (freeSlot == IRLEARN_SLOTS) {
+        freeSlot = s;
+      }
+    } else if (table[s].code == code) {
+      return s;
+    }
+    s = (s + 1) & (IRLEARN_SLOTS - 1);
+  }
+  return freeSlot;
+}
+
+uint16_t irlearn_lookup(uint32_t code) {
+  uint8_t s = findSlot(code);
+  if (s == IRLEARN_SLOTS || table[s].code != code || table[s].target == IRLEARN_DELETED) {
+    return IRLEARN_NONE;
+  }
+  return table[s].target;
+}
+
+void irlearn_start(void) {
+  state = STATE_CODE;
+}
+
+void irlearn_stop(void) {
+  state = STATE_IDLE;
+}
+
+uint8_t irlearn_learning(void) {
+  return state != STATE_IDLE;
+}
+
+uint8_t irlearn_pending(void) {
+  return state == STATE_TARGET;
+}
+
+uint8_t irlearn_bind(uint16_t target) {
+  if (state != STATE_TARGET) {
+    return 0;
+  }
+  state = STATE_CODE;
+  uint8_t s = findSlot(pending);
+  if (s == IRLEARN_SLOTS) {
+    return 0;
+  }
+  uint8_t found = table[s].code == pending && table[s].target < IRLEARN_DELETED;
+  if (target == IRLEARN_NONE) {
+    if (found) {
+      table[s].target = IRLEARN_DELETED;
+      used--;
+      saveTarget(s);
+    }
+    return 1;
+  }
+  if (!found && used >= IRLEARN_MAX) {
+    return 0;
+  }
+  if (eeprom_read_byte((const uint8_t *)IRLEARN_EEPROM_START) != IRLEARN_MAGIC) {
+    // The area may hold an old recorder log, start from an empty table
+    for (uint8_t i = 0; i < IRLEARN_SLOTS; i++) {
+      saveTarget(i);
+    }
+    eeprom_update_byte((uint8_t *)IRLEARN_EEPROM_START, IRLEARN_MAGIC);
+  }
+  used += !found;
+  table[s].code = pending;
+  table[s].target = target;
+  saveSlot(s);
+  return 1;
+}
+
+void irlearn_frame(uint32_t code) {
+  if (code == IR_OTHER_REPEAT) {
+    // Button of the held key is still down
+    if (held != IRLEARN_NONE && next == IRLEARN_NONE) {
+      expires = millis() + IRLEARN_HOLD_MS;
+    }
+    return;
+  }
+  if (state != STATE_IDLE) {
+    pending = code;
+    state = STATE_TARGET;
+    return;
+  }
+  uint16_t t = irlearn_lookup(code);
+  if (t == IRLEARN_NONE) {
+    return;
+  }
+  if (t != held) {
+    next = t;
+  }
+  expires = millis() + IRLEARN_HOLD_MS;
+}
+
+uint8_t irlearn_busy(void) {
+  return next != IRLEARN_NONE
+    || (held != IRLEARN_NONE && (long)(expires - millis()) < 0);
+}
+
+uint8_t irlearn_poll(uint16_t *t) {
+  if (!irlearn_busy()) {
+    return 0;
+  }
+  // Another button releases the held key first
+  if (held != IRLEARN_NONE) {
+    *t = held;
+    held = IRLEARN_NONE;
+    return 1;
+  }
+  held = next;
+  next = IRLEARN_NONE;
+  *t = held | FLAG_KEYDOWN;
+  return 1;
+}
@@ -0,0 +1,68 @@
+/*
+  irlearn.h - Buttons of other IR remotes learned as C64 keys
+
+  Copyright (c) 2022 Jarkko Sonninen
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef irlearn_h
+#define irlearn_h
+
+#include <stdint.h>
+#include <avr/io.h>
+
+/* Frames of other remotes are known by IR_readOther() codes. Learned
+ * codes are kept in an open addressing hash table with linear probing,
+ * loaded to RAM at start and written through to the top of EEPROM.
+ * Other remotes send no release frame, so a learned key is held until
+ * IRLEARN_HOLD_MS after the last frame or repeat frame of its button.
+ *
+ * EEPROM layout
+ *  IRLEARN_EEPROM_START: magic
+ *  then IRLEARN_SLOTS entries of code, 32 bits, and target, 16 bits
+ */
+#define IRLEARN_SLOTS 32    // A power of two
+#define IRLEARN_MAX 24      // Learned codes, leaves the probes short
+#define IRLEARN_HOLD_MS 150 // Longer than the repeat interval of remotes
+#define IRLEARN_EEPROM_SIZE (1 + IRLEARN_SLOTS * 6)
+#define IRLEARN_EEPROM_START (E2END + 1 - IRLEARN_EEPROM_SIZE)
+
+// Target is a c64key() code with its flags, or IRLEARN_JOY and joystick
+// bits 0..4: up, down, left, right, button
+#define IRLEARN_JOY 0x1000
+#define IRLEARN_NONE 0xffff
+
+// Load the table from EEPROM
+void irlearn_begin(void);
+// Next frames of other remotes are learned, until irlearn_stop()
+void irlearn_start(void);
+void irlearn_stop(void);
+uint8_t irlearn_learning(void);
+// A code is waiting for its target
+uint8_t irlearn_pending(void);
+// Bind the waiting code to a target, IRLEARN_NONE forgets it.
+// Returns 0 if the table is full.
+uint8_t irlearn_bind(uint16_t target);
+// Frame of another remote from IR_readOther()
+void irlearn_frame(uint32_t code);
+uint16_t irlearn_lookup(uint32_t code);
+// Call from loop(). Returns 1 and a target in 't' when a learned key
+// changes, with FLAG_KEYDOWN when pressed.
+uint8_t irlearn_poll(uint16_t *t);
+// irlearn_poll() has work to do now
+uint8_t irlearn_busy(void);
+
+#endif
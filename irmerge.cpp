@@ -0,0 +1,67 @@
+/*
+  irmerge.cpp - Merge of frames from several IR receivers
+
+  Copyright (c) 2022 Jarkko Sonninen
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include <string.h>
+
+#include "irmerge.h"
+
+struct lastFrame {
+  uint32_t event;
+  uint32_t time_us;
+  uint8_t valid;
+};
+
+static lastFrame last[IR_RECEIVERS];
+static irmerge_stats stats;
+
+void irmerge_reset(void) {
+  memset(last, 0, sizeof(last));
+  memset(&stats, 0, sizeof(stats));
+}
+
+uint8_t irmerge_frame(uint8_t receiver, uint32_t event, uint32_t time_us) {
+  uint8_t duplicate = 0;
+  for (uint8_t r = 0; r < IR_RECEIVERS; r++) {
+    if (r != receiver && last[r].valid && last[r].event == event
+        && time_us - last[r].time_us < IR_MERGE_WINDOW_US) {
+      duplicate = 1;
+      // A frame is merged only once
+      last[r].valid = 0;
+    }
+  }
+  if (!duplicate) {
+    last[receiver].event = event;
+    last[receiver].time_us = time_us;
+    last[receiver].valid = 1;
+  } else {
+    last[receiver].valid = 0;
+  }
+  stats.decoded[receiver]++;
+  if (duplicate) {
+    stats.duplicates++;
+  } else {
+    stats.first[receiver]++;
+  }
+  return !duplicate;
+}
+
+const irmerge_stats *irmerge_getStats(void) {
+  return &stats;
+}
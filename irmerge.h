@@ -0,0 +1,47 @@
+/*
+  irmerge.h - Merge of frames from several IR receivers
+
+  Copyright (c) 2022 Jarkko Sonninen
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef irmerge_h
+#define irmerge_h
+
+#include <stdint.h>
+
+/* Every receiver decodes the frames it captures on its own. A frame
+ * decoded by one receiver is a duplicate if another receiver decoded the
+ * same event within IR_MERGE_WINDOW_US. The window is shorter than the
+ * shortest frame plus the 5 ms end gap, so real repeats of the same key
+ * or stick position are never merged. The first receiver to decode a frame
+ * wins, so a second receiver adds no latency.
+ */
+#define IR_RECEIVERS 2
+#define IR_MERGE_WINDOW_US 15000
+
+struct irmerge_stats {
+  uint16_t decoded[IR_RECEIVERS]; // Valid frames decoded by each receiver
+  uint16_t first[IR_RECEIVERS];   // Frames where the receiver was the first
+  uint16_t duplicates;            // Frames dropped as duplicates
+};
+
+void irmerge_reset(void);
+// Returns 1 if the event is new, 0 if it is a duplicate
+uint8_t irmerge_frame(uint8_t receiver, uint32_t event, uint32_t time_us);
+const irmerge_stats *irmerge_getStats(void);
+
+#endif
@@ -0,0 +1,48 @@
+/*
+  joyfilter.cpp - Joystick axis hysteresis and smoothing
+
+  Copyright (c) 2022 Jarkko Sonninen
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include <string.h>
+
+#include "joyfilter.h"
+
+void joyfilter_reset(joyfilter *f) {
+  memset(f, 0, sizeof(*f));
+}
+
+int8_t joyfilter_update(joyfilter *f, int8_t value, uint8_t limit) {
+  f->samples[f->next] = value;
+  f->next = (f->next + 1) % JOYFILTER_WINDOW;
+
+  if (value >= limit) {
+    f->direction = 1;
+  } else if (value <= -limit) {
+    f->direction = -1;
+  } else if (f->direction) {
+    int16_t sum = 0;
+    for (uint8_t i = 0; i < JOYFILTER_WINDOW; i++) {
+      sum += f->samples[i];
+    }
+    // Mean in the held direction
+    if (sum * f->direction < JOYFILTER_RELEASE(limit) * JOYFILTER_WINDOW) {
+      f->direction = 0;
+    }
+  }
+  return f->direction;
+}
@@ -0,0 +1,47 @@
+/*
+  joyfilter.h - Joystick axis hysteresis and smoothing
+
+  Copyright (c) 2022 Jarkko Sonninen
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef joyfilter_h
+#define joyfilter_h
+
+#include <stdint.h>
+
+/* Turns stick axis samples into a direction, -1, 0 or 1. A direction is
+ * engaged when a sample reaches the move limit and held until the mean
+ * of the last JOYFILTER_WINDOW samples falls below the release limit, so
+ * a stick held near the limit does not toggle the pins on every frame.
+ * Engaging uses the newest sample only and adds no latency. A longer
+ * window also rides over single noisy samples, but delays the release
+ * of a stick flicked back to center by up to WINDOW - 1 frames.
+ */
+#define JOYFILTER_WINDOW 1 // Samples averaged for release, 1 disables smoothing
+#define JOYFILTER_RELEASE(limit) ((limit) / 2)
+
+typedef struct {
+  int8_t samples[JOYFILTER_WINDOW];
+  uint8_t next;
+  int8_t direction;
+} joyfilter;
+
+void joyfilter_reset(joyfilter *f);
+// Returns the filtered direction after 'value', positive is up or right
+int8_t joyfilter_update(joyfilter *f, int8_t value, uint8_t limit);
+
+#endif
@@ -0,0 +1,85 @@
+/*
+  joymix.cpp - Joystick directions mixed from several sources
+
+  Copyright (c) 2022 Jarkko Sonninen
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include <Arduino.h>
+
+#include "joymix.h"
+#include "trace.h"
+
+static int pins[4];
+static uint8_t sources[JOYMIX_SOURCES];
+static uint8_t output;
+
+// value==1 means direction pushed
+static void writePin(int pin, uint8_t value) {
+  TRACE(TRACE_JOY, pin, value);
+  if (value) {
+    pinMode(pin, OUTPUT);
+    digitalWrite(pin, LOW);
+  } else {
+    pinMode(pin, INPUT_PULLUP);
+  }
+}
+
+void joymix_begin(int upPin, int downPin, int leftPin, int rightPin) {
+  pins[0] = upPin;
+  pins[1] = downPin;
+  pins[2] = leftPin;
+  pins[3] = rightPin;
+  for (uint8_t i = 0; i < JOYMIX_SOURCES; i++) {
+    sources[i] = 0;
+  }
+  output = 0;
+}
+
+// Opposite directions cancel
+static uint8_t arbitrate(uint8_t bits) {
+  if ((bits & (JOYMIX_UP | JOYMIX_DOWN)) == (JOYMIX_UP | JOYMIX_DOWN)) {
+    bits &= ~(JOYMIX_UP | JOYMIX_DOWN);
+  }
+  if ((bits & (JOYMIX_LEFT | JOYMIX_RIGHT)) == (JOYMIX_LEFT | JOYMIX_RIGHT)) {
+    bits &= ~(JOYMIX_LEFT | JOYMIX_RIGHT);
+  }
+  return bits;
+}
+
+void joymix_set(uint8_t source, uint8_t bits) {
+  sources[source] = bits & 0xf;
+  uint8_t mixed = 0;
+  for (uint8_t i = 0; i < JOYMIX_SOURCES; i++) {
+    mixed |= sources[i];
+  }
+  mixed = arbitrate(mixed);
+  uint8_t changed = mixed ^ output;
+  output = mixed;
+  for (uint8_t i = 0; i < 4; i++) {
+    if (changed & (1 << i)) {
+      writePin(pins[i], (mixed >> i) & 1);
+    }
+  }
+}
+
+uint8_t joymix_get(uint8_t source) {
+  return sources[source];
+}
+
+uint8_t joymix_output(void) {
+  return output;
+}
@@ -0,0 +1,50 @@
+/*
+  joymix.h - Joystick directions mixed from several sources
+
+  Copyright (c) 2022 Jarkko Sonninen
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef joymix_h
+#define joymix_h
+
+#include <stdint.h>
+
+/* The remote stick, keyboard joystick mode and learned buttons each keep
+ * their own direction bits. The port gets them ORed, and a pin is written
+ * only when its mixed state changes. Up with down, or left with right, is
+ * neither, as no real stick closes both and programs read it as anything.
+ * The button has its sources in autofire.h.
+ */
+#define JOYMIX_STICK 0   // Remote stick
+#define JOYMIX_KEYB 1    // Keyboard joystick mode
+#define JOYMIX_LEARNED 2 // Learned button of another remote
+#define JOYMIX_SOURCES 3
+
+// Direction bits, as setJoy1()
+#define JOYMIX_UP 0x01
+#define JOYMIX_DOWN 0x02
+#define JOYMIX_LEFT 0x04
+#define JOYMIX_RIGHT 0x08
+
+// Pins are open collector, released at start
+void joymix_begin(int upPin, int downPin, int leftPin, int rightPin);
+void joymix_set(uint8_t source, uint8_t bits);
+uint8_t joymix_get(uint8_t source);
+// Directions on the port
+uint8_t joymix_output(void);
+
+#endif
@@ -0,0 +1,207 @@
+/*
+  keysched.cpp - Minimum hold and gap for live key presses
+
+  Copyright (c) 2022 Jarkko Sonninen
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include <Arduino.h>
+
+#include "C64keyboard.hpp"
+#include "c64key.h"
+#include "keysched.h"
+
+struct heldKey {
+  uint8_t key; // CK_IGNORE_KEYCODE if free
+  uint32_t since;
+};
+
+#define NEXT_NONE 0xff
+#define NEXT_QUEUE 0xfe // Head of the queue, else an urgent lane index
+
+static uint16_t queue[KEYSCHED_QUEUE]; // Presses and releases of queued presses
+static uint8_t head, len;
+static uint16_t urgent[KEYSCHED_URGENT];
+static uint8_t urgentLen;
+static heldKey held[KEYSCHED_HELD];
+static uint32_t lastPress;
+static uint8_t lastUp;      // Last released key
+static uint32_t lastUpTime;
+
+void keysched_begin(void) {
+  len = 0;
+  urgentLen = 0;
+  for (uint8_t i = 0; i < KEYSCHED_HELD; i++) {
+    held[i].key = CK_IGNORE_KEYCODE;
+  }
+  lastPress = millis() - KEYSCHED_GAP_MS;
+  lastUp = CK_IGNORE_KEYCODE;
+}
+
+static uint8_t isModifier(uint8_t c) {
+  return c == CKM_L_SHIFT || c == CKM_R_SHIFT || c == CKM_CBM || c == CKM_CTRL;
+}
+
+static heldKey *findHeld(uint8_t c) {
+  for (uint8_t i = 0; i < KEYSCHED_HELD; i++) {
+    if (held[i].key == c) {
+      return &held[i];
+    }
+  }
+  return NULL;
+}
+
+static inline void notBefore(uint32_t *t, uint32_t limit) {
+  if ((int32_t)(limit - *t) > 0) {
+    *t = limit;
+  }
+}
+
+// Earliest time the event may reach the matrix
+static uint32_t dueTime(uint16_t ck, uint32_t now) {
+  uint8_t c = ck & 0xff;
+  uint32_t t = now;
+  if (c >= 0x40) {
+    // RESTORE and other codes that the keyboard scan does not see
+    return t;
+  }
+  if (ck & FLAG_KEYDOWN) {
+    if (!isModifier(c)) {
+      notBefore(&t, lastPress + KEYSCHED_GAP_MS);
+    }
+    if (c == lastUp) {
+      notBefore(&t, lastUpTime + KEYSCHED_GAP_MS);
+    }
+  } else {
+    heldKey *h = findHeld(c);
+    if (h) {
+      notBefore(&t, h->since + KEYSCHED_HOLD_MS);
+    }
+  }
+  return t;
+}
+
+// Bookkeeping of an event applied at 'now'
+static void applied(uint16_t ck, uint32_t now) {
+  uint8_t c = ck & 0xff;
+  if (c >= 0x40) {
+    return;
+  }
+  heldKey *h = findHeld(c);
+  if (ck & FLAG_KEYDOWN) {
+    if (!isModifier(c)) {
+      lastPress = now;
+    }
+    if (!h) {
+      h = findHeld(CK_IGNORE_KEYCODE);
+    }
+    if (h) {
+      h->key = c;
+      h->since = now;
+    }
+  } else {
+    if (h) {
+      h->key = CK_IGNORE_KEYCODE;
+    }
+    lastUp = c;
+    lastUpTime = now;
+  }
+}
+
+static uint8_t inUrgent(uint8_t c, uint8_t before) {
+  for (uint8_t i = 0; i < before; i++) {
+    if ((urgent[i] & 0xff) == c) {
+      return 1;
+    }
+  }
+  return 0;
+}
+
+static uint8_t inQueue(uint8_t c) {
+  for (uint8_t i = 0; i < len; i++) {
+    if ((queue[(head + i) & (KEYSCHED_QUEUE - 1)] & 0xff) == c) {
+      return 1;
+    }
+  }
+  return 0;
+}
+
+// Next due event, urgent events first. Events of one key are never
+// reordered.
+static uint8_t nextDue(uint32_t now) {
+  for (uint8_t i = 0; i < urgentLen; i++) {
+    if (!inUrgent(urgent[i] & 0xff, i) && (int32_t)(dueTime(urgent[i], now) - now) <= 0) {
+      return i;
+    }
+  }
+  if (len && !inUrgent(queue[head] & 0xff, urgentLen)
+      && (int32_t)(dueTime(queue[head], now) - now) <= 0) {
+    return NEXT_QUEUE;
+  }
+  return NEXT_NONE;
+}
+
+uint8_t keysched_key(uint16_t ck) {
+  uint8_t c = ck & 0xff;
+  if (c == CK_RESET && (ck & FLAG_KEYDOWN)) {
+    // All keys go up, queued presses would come back after it
+    len = 0;
+    urgentLen = 0;
+    for (uint8_t i = 0; i < KEYSCHED_HELD; i++) {
+      held[i].key = CK_IGNORE_KEYCODE;
+    }
+  }
+  if (c >= 0x40 || (!(ck & FLAG_KEYDOWN) && !inQueue(c))) {
+    if (urgentLen == KEYSCHED_URGENT) {
+      return 0;
+    }
+    urgent[urgentLen++] = ck;
+    return 1;
+  }
+  if (len == KEYSCHED_QUEUE) {
+    return 0;
+  }
+  queue[(head + len) & (KEYSCHED_QUEUE - 1)] = ck;
+  len++;
+  return 1;
+}
+
+uint8_t keysched_busy(void) {
+  return nextDue(millis()) != NEXT_NONE;
+}
+
+uint8_t keysched_poll(uint16_t *ck) {
+  uint32_t now = millis();
+  uint8_t i = nextDue(now);
+  if (i == NEXT_NONE) {
+    return 0;
+  }
+  uint16_t k;
+  if (i != NEXT_QUEUE) {
+    k = urgent[i];
+    urgentLen--;
+    for (; i < urgentLen; i++) {
+      urgent[i] = urgent[i + 1];
+    }
+  } else {
+    k = queue[head];
+    head = (head + 1) & (KEYSCHED_QUEUE - 1);
+    len--;
+  }
+  applied(k, now);
+  *ck = k;
+  return 1;
+}
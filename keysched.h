@@ -0,0 +1,57 @@
+/*
+  keysched.h - Minimum hold and gap for live key presses
+
+  Copyright (c) 2022 Jarkko Sonninen
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef keysched_h
+#define keysched_h
+
+#include <stdint.h>
+
+/* Key presses and releases from the keymap pass through a queue on the
+ * way to the matrix, so that the KERNAL scan every 1/60 s sees each of
+ * them. A key is held at least KEYSCHED_HOLD_MS, a key press comes at
+ * least KEYSCHED_GAP_MS after the previous one, and a key pressed again
+ * waits KEYSCHED_GAP_MS after its release. Shift, C= and CTRL are read
+ * with every key and are not spaced. Events are kept in order, and one
+ * that meets its limits with nothing queued before it is not delayed.
+ * IR frames are always further apart than this, wired keys may not be.
+ *
+ * RESTORE, RESET and other codes from 0x40 up, and releases of keys that
+ * are down, go in an urgent lane ahead of queued presses. Codes from 0x40
+ * up are due at once and releases after their hold, so nothing queued
+ * delays them more than KEYSCHED_HOLD_MS. Events of one key keep their
+ * order. RESET drops everything queued, as it releases all keys.
+ */
+#define KEYSCHED_HOLD_MS 20
+#define KEYSCHED_GAP_MS 20
+#define KEYSCHED_QUEUE 16 // Events, a power of two
+#define KEYSCHED_URGENT 8 // Urgent lane events
+#define KEYSCHED_HELD 6   // Pressed keys whose hold is tracked
+
+void keysched_begin(void);
+// c64key() code of a key press or release. Returns 0 if its lane is
+// full, the caller then gives it to c64key() at once.
+uint8_t keysched_key(uint16_t ck);
+// Returns 1 and a c64key() code in 'ck' when the next event is due.
+// Call until it returns 0.
+uint8_t keysched_poll(uint16_t *ck);
+// keysched_poll() has work to do now
+uint8_t keysched_busy(void);
+
+#endif
@@ -0,0 +1,155 @@
+/*
+  macro.cpp - Typing text into the keyboard matrix
+
+  Copyright (c) 2022 Jarkko Sonninen
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include <Arduino.h>
+
+#include "C64keyboard.hpp"
+#include "c64key.h"
+#include "macro.h"
+
+#define S(k) ((k) | MACRO_SHIFT)
+#define NONE MACRO_NO_KEY
+
+// ASCII 0x20..0x7f to C64 keys, \ is the pound key as in PETSCII
+static const uint8_t asciiKeys[0x60] PROGMEM = {
+  CKM_SPACE, S(CKM_1), S(CKM_2), S(CKM_3), S(CKM_4), S(CKM_5), S(CKM_6), S(CKM_7),
+  S(CKM_8), S(CKM_9), CKM_ASTERISK, CKM_PLUS, CKM_COMMA, CKM_MINUS, CKM_PERIOD, CKM_SLASH,
+  CKM_0, CKM_1, CKM_2, CKM_3, CKM_4, CKM_5, CKM_6, CKM_7,
+  CKM_8, CKM_9, CKM_COLON, CKM_SEMICOLON, S(CKM_COMMA), CKM_EQUAL, S(CKM_PERIOD), S(CKM_SLASH),
+  CKM_AT, CKM_A, CKM_B, CKM_C, CKM_D, CKM_E, CKM_F, CKM_G,
+  CKM_H, CKM_I, CKM_J, CKM_K, CKM_L, CKM_M, CKM_N, CKM_O,
+  CKM_P, CKM_Q, CKM_R, CKM_S, CKM_T, CKM_U, CKM_V, CKM_W,
+  CKM_X, CKM_Y, CKM_Z, S(CKM_COLON), CKM_POUND, S(CKM_SEMICOLON), CKM_UP_ARROW, CKM_LEFT_ARROW,
+  NONE, CKM_A, CKM_B, CKM_C, CKM_D, CKM_E, CKM_F, CKM_G,
+  CKM_H, CKM_I, CKM_J, CKM_K, CKM_L, CKM_M, CKM_N, CKM_O,
+  CKM_P, CKM_Q, CKM_R, CKM_S, CKM_T, CKM_U, CKM_V, CKM_W,
+  CKM_X, CKM_Y, CKM_Z, NONE, NONE, NONE, NONE, NONE,
+};
+
+static const char *text;   // PROGMEM string being typed, NULL if none
+static char queue[MACRO_QUEUE];
+static uint8_t head, len;
+static char lastQueued;
+static uint16_t key = CK_IGNORE_KEYCODE; // Pressed key without FLAG_KEYDOWN
+static uint8_t pending = MACRO_NO_KEY;   // Next key, taken at the release
+static uint32_t nextTime;
+
+uint8_t macro_ascii(char c) {
+  if (c == '\r' || c == '\n') {
+    return CKM_RETURN;
+  }
+  // char is signed on AVR, bytes above 0x7f would be negative
+  uint8_t u = (uint8_t)c;
+  if (u < 0x20 || u > 0x7f) {
+    return MACRO_NO_KEY;
+  }
+  return pgm_read_byte(&asciiKeys[u - 0x20]);
+}
+
+void macro_start(const char *s) {
+  text = s;
+  pending = MACRO_NO_KEY;
+}
+
+uint8_t macro_char(char c) {
+  // A CR LF line end is one RETURN
+  char last = lastQueued;
+  lastQueued = c;
+  if (c == '\n' && last == '\r') {
+    return 1;
+  }
+  if (len >= MACRO_QUEUE) {
+    return 0;
+  }
+  queue[(head + len) & (MACRO_QUEUE - 1)] = c;
+  len++;
+  return 1;
+}
+
+uint8_t macro_full(void) {
+  return len >= MACRO_QUEUE;
+}
+
+// A pressed key is still released by macro_poll()
+void macro_stop(void) {
+  text = NULL;
+  len = 0;
+  pending = MACRO_NO_KEY;
+}
+
+static char nextChar(void) {
+  if (text) {
+    char c = pgm_read_byte(text++);
+    if (c) {
+      return c;
+    }
+    text = NULL;
+  }
+  if (len) {
+    char c = queue[head];
+    head = (head + 1) & (MACRO_QUEUE - 1);
+    len--;
+    return c;
+  }
+  return 0;
+}
+
+static uint8_t nextKey(void) {
+  char c;
+  while ((c = nextChar())) {
+    uint8_t k = macro_ascii(c);
+    if (k != MACRO_NO_KEY) {
+      return k;
+    }
+  }
+  return MACRO_NO_KEY;
+}
+
+uint8_t macro_busy(void) {
+  return (key != CK_IGNORE_KEYCODE || pending != MACRO_NO_KEY || text || len)
+    && (long)(nextTime - millis()) <= 0;
+}
+
+uint8_t macro_poll(uint16_t *ck) {
+  if (!macro_busy()) {
+    return 0;
+  }
+  if (key != CK_IGNORE_KEYCODE) {
+    *ck = key;
+    pending = nextKey();
+    // The same key again waits for the release to be scanned
+    uint8_t same = pending != MACRO_NO_KEY && (pending & ~MACRO_SHIFT) == (key & 0xff);
+    nextTime = millis() + (same ? MACRO_GAP_MS : 0);
+    key = CK_IGNORE_KEYCODE;
+    return 1;
+  }
+  uint8_t k = pending != MACRO_NO_KEY ? pending : nextKey();
+  pending = MACRO_NO_KEY;
+  if (k == MACRO_NO_KEY) {
+    return 0;
+  }
+  key = k & ~MACRO_SHIFT;
+  if (k & MACRO_SHIFT) {
+    key |= FLAG_AUTOSHIFT;
+  }
+  *ck = key | FLAG_KEYDOWN;
+  nextTime = millis() + MACRO_HOLD_MS;
+  return 1;
+}
@@ -0,0 +1,54 @@
+/*
+  macro.h - Typing text into the keyboard matrix
+
+  Copyright (c) 2022 Jarkko Sonninen
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef macro_h
+#define macro_h
+
+#include <stdint.h>
+
+/* Text from keymap macros and Serial is typed into the matrix one key at
+ * a time. The KERNAL scans the keyboard every 1/60 s, so every key is
+ * held a little longer than one scan, with margin for interrupts the C64
+ * delays and for the 1 ms resolution of millis(). The next key is pressed right after
+ * the release, only the same key again waits a scan for the release to be
+ * seen. Shifted characters use auto shift. Upper and lower case letters
+ * are both typed unshifted, as the C64 shows them in upper case mode.
+ */
+#define MACRO_HOLD_MS 20
+#define MACRO_GAP_MS 20
+#define MACRO_QUEUE 32 // Serial characters, a power of two
+
+// macro_ascii() result, CKM_ code with MACRO_SHIFT, or MACRO_NO_KEY
+#define MACRO_SHIFT 0x40
+#define MACRO_NO_KEY 0xff
+
+// Type a PROGMEM string, replacing one being typed
+void macro_start(const char *text);
+// Queue one character, returns 0 if the queue is full
+uint8_t macro_char(char c);
+uint8_t macro_full(void);
+void macro_stop(void);
+// Call from loop(). Returns 1 and a c64key() code in 'ck' when a key changes.
+uint8_t macro_poll(uint16_t *ck);
+// macro_poll() has work to do now
+uint8_t macro_busy(void);
+uint8_t macro_ascii(char c);
+
+#endif
@@ -36,6 +36,27 @@ typedef struct {
   uint8_t flags;
 } C64Keymap_t;
 
+typedef struct {
+  uint16_t delay; // Milliseconds before the first repeat
+  uint8_t rate;   // Repeats per second, 0 disables repeat
+} C64Typematic_t;
+
+const PROGMEM C64Typematic_t C64Typematic_main = { 500, 10 };
+
+// Text typed by keys mapped with CKM_MACRO, ckmKey is the index here
+#define MACRO_FLAGS (IR_NO_SHIFT | IR_SHIFT | CKM_MACRO)
+const char C64Macro_load[] PROGMEM = "LOAD\"*\",8,1\r";
+const char C64Macro_run[] PROGMEM = "RUN\r";
+const char C64Macro_dir[] PROGMEM = "LOAD\"$\",8\r";
+const char C64Macro_list[] PROGMEM = "LIST\r";
+
+const char * const C64Macros[] PROGMEM = {
+  C64Macro_load,
+  C64Macro_run,
+  C64Macro_dir,
+  C64Macro_list,
+};
+
 const PROGMEM C64Keymap_t C64Keymap_main[] = {
 { IR_KC_L_SHIFT, CKM_L_SHIFT, DEF_FLAGS },
 { IR_KC_L_CTRL, CKM_CBM, DEF_FLAGS },
@@ -107,10 +128,10 @@ const PROGMEM C64Keymap_t C64Keymap_main[] = {
 //{ IR_KC_DEL, CKM_DEL },
 //{ IR_KC_PGUP, CKM_PGUP },
 //{ IR_KC_PGDN, CKM_PGDN },
-{ IR_KC_UP_ARROW, CKM_CRSR_DOWN, IR_NO_SHIFT | IR_SHIFT | CKM_SHIFT | CKM_NO_SHIFT},
-{ IR_KC_DN_ARROW, CKM_CRSR_DOWN, DEF_FLAGS },
-{ IR_KC_L_ARROW, CKM_CRSR_RIGHT, IR_NO_SHIFT | IR_SHIFT | CKM_SHIFT | CKM_NO_SHIFT},
-{ IR_KC_R_ARROW, CKM_CRSR_RIGHT, DEF_FLAGS },
+{ IR_KC_UP_ARROW, CKM_CRSR_DOWN, IR_NO_SHIFT | IR_SHIFT | CKM_SHIFT | CKM_NO_SHIFT | CKM_REPEAT},
+{ IR_KC_DN_ARROW, CKM_CRSR_DOWN, DEF_FLAGS | CKM_REPEAT },
+{ IR_KC_L_ARROW, CKM_CRSR_RIGHT, IR_NO_SHIFT | IR_SHIFT | CKM_SHIFT | CKM_NO_SHIFT | CKM_REPEAT},
+{ IR_KC_R_ARROW, CKM_CRSR_RIGHT, DEF_FLAGS | CKM_REPEAT },
 { IR_KC_HASH, CKM_EQUAL, DEF_FLAGS },
 { IR_KC_LBRACKET, CKM_AT, DEF_FLAGS },
 { IR_KC_RBRACKET, CKM_ASTERISK, DEF_FLAGS },
@@ -118,7 +139,7 @@ const PROGMEM C64Keymap_t C64Keymap_main[] = {
 { IR_KC_AT, CKM_SEMICOLON, DEF_FLAGS },
 { IR_KC_PERIOD, CKM_PERIOD, DEF_FLAGS },
 { IR_KC_COMMA, CKM_COMMA, DEF_FLAGS },
-{ IR_KC_BACKSPACE, CKM_DEL, DEF_FLAGS },
+{ IR_KC_BACKSPACE, CKM_DEL, DEF_FLAGS | CKM_REPEAT },
 { IR_KC_DIV, CKM_SLASH, DEF_FLAGS },
 { IR_KC_BACKSLASH, CK_CAPSLOCK, IR_NO_SHIFT | IR_SHIFT },
 { IR_KC_SPACE, CKM_SPACE, DEF_FLAGS },
@@ -142,12 +163,12 @@ const PROGMEM C64Keymap_t C64Keymap_main[] = {
 //{ IR_KC_KP_MINUS, CKM_KP_MINUS },
 //{ IR_KC_KP_TIMES, CKM_KP_TIMES },
 { IR_KC_CLOSE, CK_RESET, DEF_FLAGS },
+{ IR_KC_WEB, 0, MACRO_FLAGS },
+{ IR_KC_CALC, 1, MACRO_FLAGS },
+{ IR_KC_FULLSCREEN, 2, MACRO_FLAGS },
+{ IR_KC_WINDOW, 3, MACRO_FLAGS },
 /*
-{ IR_KC_FULLSCREEN, CKM_FULLSCREEN },
-{ IR_KC_WINDOW, CKM_WINDOW },
 { IR_KC_HELP, CKM_HELP },
-{ IR_KC_CALC, CKM_CALC },
-{ IR_KC_WEB, CKM_WEB },
 { IR_KC_EJECT, CKM_EJECT },
 { IR_KC_PREV_TR, CKM_PREV_TR },
 { IR_KC_PLAY, CKM_PLAY },
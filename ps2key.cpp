@@ -0,0 +1,294 @@
+/*
+  ps2key.cpp - Interrupt driven PS/2 keyboard input
+
+  Copyright (c) 2022 Jarkko Sonninen
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include <Arduino.h>
+
+#include "irkey.h"
+#include "irkeys.h"
+#include "ps2key.h"
+
+#ifdef PS2_CLOCK_PIN
+
+#define PS2_NO_KEY 0xff // IR_KC_L_SHIFT is 0
+
+#define PS2_EXTENDED 0xe0
+#define PS2_BREAK 0xf0
+#define PS2_PAUSE 0xe1  // Pause sends E1 14 77 E1 F0 14 F0 77, no break
+#define PS2_PAUSE_LEN 8
+
+// Scan code set 2 to IR key codes, by physical key position
+static const uint8_t ps2Keys[0x84] PROGMEM = {
+  // 0x00
+  PS2_NO_KEY, IR_KC_F9, PS2_NO_KEY, IR_KC_F5, IR_KC_F3, IR_KC_F1, IR_KC_F2, IR_KC_F12,
+  PS2_NO_KEY, IR_KC_F10, IR_KC_F8, IR_KC_F6, IR_KC_F4, IR_KC_TAB, IR_KC_GRAVE, PS2_NO_KEY,
+  // 0x10
+  PS2_NO_KEY, IR_KC_L_ALT, IR_KC_L_SHIFT, PS2_NO_KEY, IR_KC_L_CTRL, IR_KC_Q, IR_KC_1, PS2_NO_KEY,
+  PS2_NO_KEY, PS2_NO_KEY, IR_KC_Z, IR_KC_S, IR_KC_A, IR_KC_W, IR_KC_2, PS2_NO_KEY,
+  // 0x20
+  PS2_NO_KEY, IR_KC_C, IR_KC_X, IR_KC_D, IR_KC_E, IR_KC_4, IR_KC_3, PS2_NO_KEY,
+  PS2_NO_KEY, IR_KC_SPACE, IR_KC_V, IR_KC_F, IR_KC_T, IR_KC_R, IR_KC_5, PS2_NO_KEY,
+  // 0x30
+  PS2_NO_KEY, IR_KC_N, IR_KC_B, IR_KC_H, IR_KC_G, IR_KC_Y, IR_KC_6, PS2_NO_KEY,
+  PS2_NO_KEY, PS2_NO_KEY, IR_KC_M, IR_KC_J, IR_KC_U, IR_KC_7, IR_KC_8, PS2_NO_KEY,
+  // 0x40
+  PS2_NO_KEY, IR_KC_COMMA, IR_KC_K, IR_KC_I, IR_KC_O, IR_KC_0, IR_KC_9, PS2_NO_KEY,
+  PS2_NO_KEY, IR_KC_PERIOD, IR_KC_DIV, IR_KC_L, IR_KC_SEMICOLON, IR_KC_P, IR_KC_MINUS, PS2_NO_KEY,
+  // 0x50
+  PS2_NO_KEY, PS2_NO_KEY, IR_KC_AT, PS2_NO_KEY, IR_KC_LBRACKET, IR_KC_EQUAL, PS2_NO_KEY, PS2_NO_KEY,
+  IR_KC_CAPS, IR_KC_R_SHIFT, IR_KC_RETURN, IR_KC_RBRACKET, PS2_NO_KEY, IR_KC_HASH, PS2_NO_KEY, PS2_NO_KEY,
+  // 0x60
+  PS2_NO_KEY, IR_KC_BACKSLASH, PS2_NO_KEY, PS2_NO_KEY, PS2_NO_KEY, PS2_NO_KEY, IR_KC_BACKSPACE, PS2_NO_KEY,
+  PS2_NO_KEY, IR_KC_KP1, PS2_NO_KEY, IR_KC_KP4, IR_KC_KP7, PS2_NO_KEY, PS2_NO_KEY, PS2_NO_KEY,
+  // 0x70
+  IR_KC_KP0, IR_KC_KP_DOT, IR_KC_KP2, IR_KC_KP5, IR_KC_KP6, IR_KC_KP8, IR_KC_ESC, IR_KC_NUM,
+  IR_KC_F11, IR_KC_KP_PLUS, IR_KC_KP3, IR_KC_KP_MINUS, IR_KC_KP_TIMES, IR_KC_KP9, IR_KC_SCROLL, PS2_NO_KEY,
+  // 0x80
+  PS2_NO_KEY, PS2_NO_KEY, PS2_NO_KEY, IR_KC_F7,
+};
+
+typedef struct {
+  uint8_t scancode;
+  uint8_t irKey;
+} ps2Extended_t;
+
+// Keys with the E0 prefix. The fake shifts around the cursor keys and
+// Print Screen (E0 12, E0 59) are not listed and so ignored.
+static const ps2Extended_t ps2Extended[] PROGMEM = {
+  { 0x11, IR_KC_L_ALT },
+  { 0x14, IR_KC_L_CTRL },
+  { 0x1f, IR_KC_L_GUI },
+  { 0x27, IR_KC_R_GUI },
+  { 0x2f, IR_KC_MENU },
+  { 0x37, IR_KC_POWER },
+  { 0x3f, IR_KC_SLEEP },
+  { 0x4a, IR_KC_KP_DIV },
+  { 0x5a, IR_KC_ENTER },
+  { 0x69, IR_KC_END },
+  { 0x6b, IR_KC_L_ARROW },
+  { 0x6c, IR_KC_HOME },
+  { 0x70, IR_KC_INS },
+  { 0x71, IR_KC_DEL1 },
+  { 0x72, IR_KC_DN_ARROW },
+  { 0x74, IR_KC_R_ARROW },
+  { 0x75, IR_KC_UP_ARROW },
+  { 0x7a, IR_KC_PGDN },
+  { 0x7c, IR_KC_PRTSCR },
+  { 0x7d, IR_KC_PGUP },
+  // Multimedia keys
+  { 0x15, IR_KC_PREV_TR },
+  { 0x21, IR_KC_VOL_DN },
+  { 0x23, IR_KC_MUTE },
+  { 0x2b, IR_KC_CALC },
+  { 0x32, IR_KC_VOL_UP },
+  { 0x34, IR_KC_PLAY },
+  { 0x3a, IR_KC_WEB },
+  { 0x3b, IR_KC_STOP },
+  { 0x4d, IR_KC_NEXT_TR },
+};
+
+// Written by the clock interrupt
+static volatile uint8_t buffer[PS2_BUFFER];
+static volatile uint8_t head, len;
+static volatile uint16_t errors;
+
+// Frame in progress, only used by the clock interrupt
+static uint8_t bitCount;
+static uint8_t shift;
+static uint8_t parity;
+static uint32_t lastClock;
+
+// Translation state, only used by read_PS2()
+static uint8_t extended;
+static uint8_t released;
+static uint8_t pauseSkip;
+static uint8_t pauseRelease;
+static uint8_t held[32]; // Bit per IR key code
+
+// Data is valid on the falling clock edge. Frames are a start bit (0),
+// 8 data bits LSB first, odd parity and a stop bit (1).
+static void ps2Clock(void) {
+  uint8_t bit = digitalRead(PS2_DATA_PIN);
+  uint32_t now = micros();
+  if (now - lastClock > PS2_TIMEOUT_US) {
+    bitCount = 0;
+  }
+  lastClock = now;
+
+  if (bitCount == 0) {
+    if (bit) {
+      return; // Not a start bit, wait for one
+    }
+    shift = 0;
+    parity = 0;
+  } else if (bitCount <= 8) {
+    shift >>= 1;
+    if (bit) {
+      shift |= 0x80;
+      parity ^= 1;
+    }
+  } else if (bitCount == 9) {
+    parity ^= bit;
+  } else {
+    bitCount = 0;
+    if (!parity || !bit) {
+      if (errors != 0xffff) {
+        errors++;
+      }
+      return;
+    }
+    if (len < PS2_BUFFER) {
+      buffer[(head + len) & (PS2_BUFFER - 1)] = shift;
+      len++;
+    }
+    return;
+  }
+  bitCount++;
+}
+
+#if PS2_CLOCK_PIN == PIN_A7
+// The comparator output rises as the clock falls below the bandgap
+ISR(ANALOG_COMP_vect) {
+  ps2Clock();
+}
+#endif
+
+void PS2_setup(void) {
+  pinMode(PS2_DATA_PIN, INPUT_PULLUP);
+#if PS2_CLOCK_PIN == PIN_A7
+  // ADC7 goes to AIN- while the ADC is off, nothing else uses analogRead()
+  ADCSRA &= ~_BV(ADEN);
+  ADCSRB |= _BV(ACME);
+  ADMUX = (ADMUX & 0xf0) | 7;
+  // Mode bits first, changing them with ACIE set may raise an interrupt
+  ACSR = _BV(ACBG) | _BV(ACIS1) | _BV(ACIS0);
+  ACSR |= _BV(ACI) | _BV(ACIE);
+#else
+  pinMode(PS2_CLOCK_PIN, INPUT_PULLUP);
+  attachInterrupt(digitalPinToInterrupt(PS2_CLOCK_PIN), ps2Clock, FALLING);
+#endif
+}
+
+uint8_t PS2_available(void) {
+  return len != 0 || pauseRelease;
+}
+
+uint16_t PS2_errors(void) {
+  return errors;
+}
+
+static uint8_t readByte(void) {
+  cli();
+  uint8_t b = buffer[head];
+  head = (head + 1) & (PS2_BUFFER - 1);
+  len--;
+  sei();
+  return b;
+}
+
+static uint8_t translate(uint8_t scancode, uint8_t ext) {
+  if (!ext) {
+    return scancode < sizeof(ps2Keys) ? pgm_read_byte(&ps2Keys[scancode]) : PS2_NO_KEY;
+  }
+  for (uint8_t i = 0; i < sizeof(ps2Extended) / sizeof(ps2Extended[0]); i++) {
+    if (pgm_read_byte(&ps2Extended[i].scancode) == scancode) {
+      return pgm_read_byte(&ps2Extended[i].irKey);
+    }
+  }
+  return PS2_NO_KEY;
+}
+
+static uint8_t isHeld(uint8_t kc) {
+  return held[kc >> 3] & (1 << (kc & 7));
+}
+
+// Both shift and GUI keys share a modifier bit, which stays set while
+// either of them is held
+static uint8_t heldModifiers(void) {
+  uint8_t m = 0;
+  if (isHeld(IR_KC_L_SHIFT) || isHeld(IR_KC_R_SHIFT)) {
+    m |= IR_MOD_SHIFT;
+  }
+  if (isHeld(IR_KC_L_ALT)) {
+    m |= IR_MOD_ALT;
+  }
+  if (isHeld(IR_KC_L_CTRL)) {
+    m |= IR_MOD_CTRL;
+  }
+  if (isHeld(IR_KC_L_GUI) || isHeld(IR_KC_R_GUI)) {
+    m |= IR_MOD_GUI;
+  }
+  return m;
+}
+
+static uint32_t keyEvent(uint8_t kc, uint8_t header) {
+  return IREvent::key(header, heldModifiers(), kc).withChecksum().raw();
+}
+
+uint32_t read_PS2(void) {
+  if (pauseRelease) {
+    pauseRelease = 0;
+    return keyEvent(IR_KC_PAUSE, IR_EV_KEYBOARD | IR_EV_RELEASE);
+  }
+  while (len) {
+    uint8_t b = readByte();
+    if (pauseSkip) {
+      if (--pauseSkip == 0) {
+        // Pause has no break code, release it on the next call
+        pauseRelease = 1;
+        return keyEvent(IR_KC_PAUSE, IR_EV_KEYBOARD);
+      }
+      continue;
+    }
+    if (b == PS2_PAUSE) {
+      pauseSkip = PS2_PAUSE_LEN - 1;
+      continue;
+    }
+    if (b == PS2_EXTENDED) {
+      extended = 1;
+      continue;
+    }
+    if (b == PS2_BREAK) {
+      released = 1;
+      continue;
+    }
+    uint8_t kc = translate(b, extended);
+    uint8_t release = released;
+    extended = 0;
+    released = 0;
+    if (kc == PS2_NO_KEY) {
+      // Keyboard replies like 0xaa after power on
+      continue;
+    }
+    uint8_t mask = 1 << (kc & 7);
+    uint8_t header = IR_EV_KEYBOARD;
+    if (release) {
+      held[kc >> 3] &= ~mask;
+      header |= IR_EV_RELEASE;
+    } else if (held[kc >> 3] & mask) {
+      header |= IR_EV_REPEAT;
+    } else {
+      held[kc >> 3] |= mask;
+    }
+    return keyEvent(kc, header);
+  }
+  return 0;
+}
+
+#endif
@@ -0,0 +1,64 @@
+/*
+  ps2key.h - Interrupt driven PS/2 keyboard input
+
+  Copyright (c) 2022 Jarkko Sonninen
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef ps2key_h
+#define ps2key_h
+
+#include <stdint.h>
+
+/* Optional wired PS/2 keyboard. The CIRKJOY board uses both external
+ * interrupt pins, D2 for RESTORE and D3 for the MT8816 data line, so the
+ * clock goes to A7 and is read by the analog comparator against the 1.1 V
+ * bandgap, which interrupts on every falling edge. A7 has no pull-up, put
+ * a 4.7 kOhm resistor from it to 5 V. A clock on D2 or D3 uses
+ * attachInterrupt() instead, if RESTORE or the MT8816 data is moved.
+ * The data pin can be any digital pin. On a Nano D13 has
+ * the L LED with a 1 kOhm resistor to GND, which holds the open collector
+ * data line at about 1.7 V, below a valid high, so 1 bits read as 0. Remove
+ * the LED or its resistor when the data is on D13, a pull-up strong
+ * enough to win is more than a PS/2 keyboard may sink.
+ */
+//#define PS2_CLOCK_PIN PIN_A7
+//#define PS2_DATA_PIN 13
+
+/* Scan code set 2 bytes are received in the clock interrupt, so a frame
+ * is never lost while loop() is busy. read_PS2() translates them to
+ * keyboard events in the same form as read_IR(), with IR_KC_ codes, so
+ * both inputs share the keymap in mapping.h. Typematic make codes of a
+ * held key become repeat events.
+ */
+#define PS2_BUFFER 16      // Received bytes, a power of two
+#define PS2_TIMEOUT_US 2000 // Clock gap that restarts a frame
+
+#ifdef PS2_CLOCK_PIN
+void PS2_setup(void);
+// Received bytes are waiting for read_PS2()
+uint8_t PS2_available(void);
+// Next keyboard event, 0 if none
+uint32_t read_PS2(void);
+// Frames with parity or framing errors, saturates at 0xffff
+uint16_t PS2_errors(void);
+#else
+#define PS2_setup()
+#define PS2_available() 0
+#define read_PS2() 0
+#endif
+
+#endif
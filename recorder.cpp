@@ -0,0 +1,169 @@
+/*
+  recorder.cpp - Record and replay of input events
+
+  Copyright (c) 2022 Jarkko Sonninen
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include <Arduino.h>
+#include <avr/eeprom.h>
+
+#include "irkey.h"
+#include "recorder.h"
+
+#define RECORDER_MAGIC 0xc7 // Changed with the IREvent layout
+#define RECORDER_HEADER 3
+
+// Bytes waiting for EEPROM write. EEPROM write takes 3.3ms per byte,
+// so the log is written one byte per loop() when EEPROM is ready.
+#define RECORDER_QUEUE 32
+
+#define STATE_IDLE 0
+#define STATE_RECORD 1
+#define STATE_PLAY 2
+
+static uint8_t state;
+static uint16_t pos;     // Next EEPROM address to write or read
+static uint16_t end;     // End of log in playback
+static uint32_t lastTime;
+static uint32_t nextTime;
+static uint8_t queue[RECORDER_QUEUE];
+static uint8_t queueHead, queueLen;
+
+static void queueByte(uint8_t b) {
+  queue[(queueHead + queueLen) % RECORDER_QUEUE] = b;
+  queueLen++;
+}
+
+static void flushQueue(void) {
+  while (queueLen) {
+    eeprom_write_byte((uint8_t *)pos++, queue[queueHead]);
+    queueHead = (queueHead + 1) % RECORDER_QUEUE;
+    queueLen--;
+  }
+}
+
+static uint32_t readDelta(void) {
+  uint32_t delta = 0;
+  uint8_t shift = 0;
+  uint8_t b;
+  do {
+    b = eeprom_read_byte((const uint8_t *)pos++);
+    delta |= (uint32_t)(b & 0x7f) << shift;
+    shift += 7;
+  } while ((b & 0x80) && pos < end);
+  return delta;
+}
+
+void recorder_start(void) {
+  recorder_stop();
+  state = STATE_RECORD;
+  pos = RECORDER_EEPROM_START + RECORDER_HEADER;
+  queueHead = queueLen = 0;
+  lastTime = millis();
+  eeprom_write_byte((uint8_t *)RECORDER_EEPROM_START, 0); // Invalidate old log
+}
+
+void recorder_play(void) {
+  recorder_stop();
+  if (eeprom_read_byte((const uint8_t *)RECORDER_EEPROM_START) != RECORDER_MAGIC) {
+    return;
+  }
+  pos = RECORDER_EEPROM_START + RECORDER_HEADER;
+  end = pos + eeprom_read_word((const uint16_t *)(RECORDER_EEPROM_START + 1));
+  // A log stopped before its first event is empty
+  if (end == pos || end > RECORDER_EEPROM_END) {
+    return;
+  }
+  state = STATE_PLAY;
+  nextTime = millis() + readDelta();
+}
+
+void recorder_stop(void) {
+  if (state == STATE_RECORD) {
+    state = STATE_IDLE;
+    flushQueue();
+    eeprom_write_word((uint16_t *)(RECORDER_EEPROM_START + 1),
+      pos - (RECORDER_EEPROM_START + RECORDER_HEADER));
+    eeprom_write_byte((uint8_t *)RECORDER_EEPROM_START, RECORDER_MAGIC);
+  }
+  state = STATE_IDLE;
+}
+
+uint8_t recorder_recording(void) {
+  return state == STATE_RECORD;
+}
+
+uint8_t recorder_playing(void) {
+  return state == STATE_PLAY;
+}
+
+void recorder_event(uint32_t data) {
+  if (state != STATE_RECORD) {
+    return;
+  }
+  // Longest entry is 5 bytes of time and 3 bytes of data.
+  // Stop when EEPROM is full or can not keep up.
+  if (pos + queueLen + 8 > RECORDER_EEPROM_END || queueLen + 8 > RECORDER_QUEUE) {
+    recorder_stop();
+    return;
+  }
+  uint32_t now = millis();
+  uint32_t delta = now - lastTime;
+  lastTime = now;
+  while (delta > 0x7f) {
+    queueByte((delta & 0x7f) | 0x80);
+    delta >>= 7;
+  }
+  queueByte(delta);
+  queueByte(data);
+  queueByte(data >> 8);
+  queueByte(data >> 16);
+}
+
+uint8_t recorder_busy(void) {
+  if (state == STATE_RECORD) {
+    return queueLen != 0;
+  }
+  return state == STATE_PLAY && (long)(nextTime - millis()) <= 0;
+}
+
+uint32_t recorder_poll(void) {
+  if (state == STATE_RECORD) {
+    if (queueLen && eeprom_is_ready()) {
+      eeprom_write_byte((uint8_t *)pos++, queue[queueHead]);
+      queueHead = (queueHead + 1) % RECORDER_QUEUE;
+      queueLen--;
+    }
+    return 0;
+  }
+  if (state != STATE_PLAY || (long)(nextTime - millis()) > 0) {
+    return 0;
+  }
+  uint32_t data = eeprom_read_byte((const uint8_t *)pos++);
+  data |= (uint32_t)eeprom_read_byte((const uint8_t *)pos++) << 8;
+  data |= (uint32_t)eeprom_read_byte((const uint8_t *)pos++) << 16;
+  if (IREvent(data).isKeyboard()) {
+    // Restore checksum dropped from the log
+    data = IREvent(data).withChecksum().raw();
+  }
+  if (pos >= end) {
+    state = STATE_IDLE;
+  } else {
+    nextTime += readDelta();
+  }
+  return data;
+}
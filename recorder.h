@@ -0,0 +1,48 @@
+/*
+  recorder.h - Record and replay of input events
+
+  Copyright (c) 2022 Jarkko Sonninen
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef recorder_h
+#define recorder_h
+
+#include "irlearn.h"
+
+/* EEPROM layout
+ *  0: magic
+ *  1: length of log, 16 bits
+ *  3: log entries
+ * Entry is delta time in milliseconds since the previous entry
+ * (7 bits per byte, high bit set when more bytes follow) followed by
+ * the three low bytes of the read_IR() event.
+ */
+#define RECORDER_EEPROM_START 0
+#define RECORDER_EEPROM_END IRLEARN_EEPROM_START // Learned remotes at the top
+
+void recorder_start(void);
+void recorder_play(void);
+void recorder_stop(void);
+void recorder_event(uint32_t data);
+uint8_t recorder_recording(void);
+uint8_t recorder_playing(void);
+// Call from loop(). Writes the log to EEPROM and returns the next replayed event or 0.
+uint32_t recorder_poll(void);
+// recorder_poll() has work to do now
+uint8_t recorder_busy(void);
+
+#endif
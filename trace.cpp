@@ -0,0 +1,83 @@
+/*
+  trace.cpp - Timeline trace of inputs and outputs
+
+  Copyright (c) 2022 Jarkko Sonninen
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include <Arduino.h>
+
+#include "trace.h"
+
+#if CIRKJOY_TRACE
+
+struct traceEntry {
+  uint32_t time;
+  uint32_t value;
+  char kind;
+  uint8_t id;
+};
+
+static traceEntry entries[TRACE_BUFFER];
+static volatile uint8_t head, len;
+static volatile uint16_t lost;
+
+void trace(char kind, uint8_t id, uint32_t value) {
+  uint8_t sreg = SREG;
+  cli();
+  if (len < TRACE_BUFFER) {
+    traceEntry &e = entries[(head + len) % TRACE_BUFFER];
+    e.time = micros();
+    e.value = value;
+    e.kind = kind;
+    e.id = id;
+    len++;
+  } else if (lost != 0xffff) {
+    lost++;
+  }
+  SREG = sreg;
+}
+
+static void printEntry(uint32_t time, char kind, uint8_t id, uint32_t value) {
+  Serial.print('@');
+  Serial.print(time);
+  Serial.print(' ');
+  Serial.print(kind);
+  Serial.print(' ');
+  Serial.print(id, HEX);
+  Serial.print(' ');
+  Serial.println(value, HEX);
+}
+
+void trace_flush(void) {
+  while (len) {
+    cli();
+    traceEntry e = entries[head];
+    head = (head + 1) % TRACE_BUFFER;
+    len--;
+    sei();
+    printEntry(e.time, e.kind, e.id, e.value);
+  }
+  if (lost) {
+    cli();
+    uint16_t n = lost;
+    lost = 0;
+    sei();
+    printEntry(micros(), TRACE_OVERFLOW, 0, n);
+  }
+}
+
+#endif
@@ -0,0 +1,60 @@
+/*
+  trace.h - Timeline trace of inputs and outputs
+
+  Copyright (c) 2022 Jarkko Sonninen
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef trace_h
+#define trace_h
+
+/* Trace lines on Serial, one per change, time in micros():
+ *  @<us> I 0 <event>   IR event from read_IR(), hex
+ *  @<us> S <code> <0|1> Matrix crosspoint from setSwitch(), code hex
+ *  @<us> J <pin> <0|1>  Joystick pin pushed (1) or released
+ *  @<us> N 0 <0|1>      NMI (RESTORE) pulled low
+ *  @<us> O 0 <n>        n entries lost because the buffer was full
+ * Entries are buffered, so that tracing is safe in interrupts and does
+ * not delay the traced code by Serial output. host/trace2vcd converts
+ * the lines to a VCD file. The last events are always kept for a
+ * post-mortem after a watchdog reset, see crashlog.h.
+ */
+
+#include "crashlog.h"
+
+#ifndef CIRKJOY_TRACE
+#define CIRKJOY_TRACE 0
+#endif
+
+#define TRACE_IR 'I'
+#define TRACE_SWITCH 'S'
+#define TRACE_JOY 'J'
+#define TRACE_NMI 'N'
+#define TRACE_OVERFLOW 'O'
+
+#if CIRKJOY_TRACE
+#define TRACE_BUFFER 16
+void trace(char kind, uint8_t id, uint32_t value);
+// Call from loop() to print buffered entries
+void trace_flush(void);
+#define TRACE(kind, id, value) do { crashlog_event(kind, id, value); trace(kind, id, value); } while (0)
+#define TRACE_FLUSH() trace_flush()
+#else
+#define TRACE(kind, id, value) crashlog_event(kind, id, value)
+#define TRACE_FLUSH()
+#endif
+
+#endif
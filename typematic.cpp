@@ -0,0 +1,91 @@
+/*
+  typematic.cpp - Local key repeat
+
+  Copyright (c) 2022 Jarkko Sonninen
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include <Arduino.h>
+
+#include "C64keyboard.hpp"
+#include "typematic.h"
+
+static uint16_t delayMs;
+static uint16_t period;
+static uint16_t key;      // Repeating key without flags
+static uint8_t active;
+static uint8_t pressed;
+static uint16_t held = CK_IGNORE_KEYCODE; // Key left up in its gap, to press again
+static uint32_t nextTime;
+
+void typematic_begin(uint16_t delay, uint8_t rate) {
+  if (rate > TYPEMATIC_RATE_MAX) {
+    rate = TYPEMATIC_RATE_MAX;
+  }
+  delayMs = delay < TYPEMATIC_GAP_MS ? TYPEMATIC_GAP_MS : delay;
+  period = rate ? 1000 / rate : 0;
+  active = 0;
+}
+
+void typematic_key(uint16_t ck) {
+  if (ck & FLAG_KEYDOWN) {
+    if (active && !pressed && (ck & 0xff) != (key & 0xff)) {
+      // The repeating key is still held but up in its gap
+      held = key;
+    }
+    // Like a PC keyboard, the last pressed key repeats
+    active = period && (ck & FLAG_TYPEMATIC);
+    key = ck & ~(FLAG_KEYDOWN | FLAG_TYPEMATIC);
+    pressed = 1;
+    nextTime = millis() + delayMs - TYPEMATIC_GAP_MS;
+  } else {
+    if ((ck & 0xff) == (key & 0xff)) {
+      active = 0;
+    }
+    if ((ck & 0xff) == (held & 0xff)) {
+      held = CK_IGNORE_KEYCODE;
+    }
+  }
+}
+
+void typematic_stop(void) {
+  active = 0;
+  held = CK_IGNORE_KEYCODE;
+}
+
+uint8_t typematic_busy(void) {
+  return held != CK_IGNORE_KEYCODE || (active && (long)(nextTime - millis()) <= 0);
+}
+
+uint8_t typematic_poll(uint16_t *ck) {
+  if (held != CK_IGNORE_KEYCODE) {
+    *ck = held | FLAG_KEYDOWN;
+    held = CK_IGNORE_KEYCODE;
+    return 1;
+  }
+  if (!typematic_busy()) {
+    return 0;
+  }
+  if (pressed) {
+    *ck = key;
+    nextTime += TYPEMATIC_GAP_MS;
+  } else {
+    *ck = key | FLAG_KEYDOWN;
+    nextTime += period - TYPEMATIC_GAP_MS;
+  }
+  pressed = !pressed;
+  return 1;
+}
@@ -0,0 +1,47 @@
+/*
+  typematic.h - Local key repeat
+
+  Copyright (c) 2022 Jarkko Sonninen
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef typematic_h
+#define typematic_h
+
+/* The matrix key is held from the IR press to the IR release. After
+ * 'delay' milliseconds a key mapped with CKM_REPEAT is released for
+ * TYPEMATIC_GAP_MS and pressed again 'rate' times per second, so that
+ * the KERNAL sees a new key press on every repeat. IR repeat frames are
+ * not used, the cadence does not depend on which of them get through.
+ * A new key pressed while the repeating key is up in its gap stops the
+ * repeat, and the old key is pressed again as it is still held.
+ */
+
+// Key up time of a repeat, longer than one 60 Hz keyboard scan
+#define TYPEMATIC_GAP_MS 20
+#define TYPEMATIC_RATE_MAX (1000 / (2 * TYPEMATIC_GAP_MS))
+
+// Rate 0 disables repeat
+void typematic_begin(uint16_t delay, uint8_t rate);
+// c64key() code of a key press or release, with FLAG_TYPEMATIC for repeating keys
+void typematic_key(uint16_t ck);
+void typematic_stop(void);
+// Call from loop(). Returns 1 and a c64key() code in 'ck' when the key changes.
+uint8_t typematic_poll(uint16_t *ck);
+// typematic_poll() has work to do now
+uint8_t typematic_busy(void);
+
+#endif